@@ -0,0 +1,179 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include<coroutine>
+#include<exception>
+#include<iostream>
+#include "vector.hpp"
+
+using namespace std;
+
+// ---------------- Coroutine task and single-threaded scheduler -------------------------
+// a Task<T> is a lazily started coroutine producing a T; awaiting it runs it and resumes the
+// awaiter when it finishes. The Scheduler resumes yielded and spawned coroutines in order, so one
+// thread can keep many requests in flight.
+
+template <typename T> class Task;
+
+// resumes the awaiter of a finished task, if any
+struct FinalAwaiter {
+	bool await_ready() noexcept { return false; }
+
+	template <typename P>
+	coroutine_handle<> await_suspend(coroutine_handle<P> handle) noexcept {
+		coroutine_handle<> continuation = handle.promise().continuation;
+		return continuation ? continuation : noop_coroutine();
+	}
+
+	void await_resume() noexcept { }
+};
+
+// state shared by the promises of every task
+struct PromiseBase {
+	coroutine_handle<> continuation;	//coroutine awaiting the task
+	exception_ptr error;				//exception thrown by the task
+
+	suspend_always initial_suspend() noexcept { return {}; }
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { error = current_exception(); }
+};
+
+// promise of a task producing a value
+template <typename T>
+struct TaskPromise : PromiseBase {
+	T value;							//value returned by the task
+
+	Task<T> get_return_object();
+	void return_value(T result) { value = static_cast<T&&>(result); }
+	T result() {
+		if (error) rethrow_exception(error);
+		return static_cast<T&&>(value);
+	}
+};
+
+// promise of a task producing nothing
+template <>
+struct TaskPromise<void> : PromiseBase {
+	Task<void> get_return_object();
+	void return_void() { }
+	void result() {
+		if (error) rethrow_exception(error);
+	}
+};
+
+template <typename T>
+class Task
+{
+	public:
+		typedef TaskPromise<T> promise_type;
+	private:
+		coroutine_handle<promise_type> handle;	//frame of the coroutine, owned by the task
+	public:
+		explicit Task(coroutine_handle<promise_type> handle) : handle(handle) { }
+		Task(Task &&other) : handle(other.handle) { other.handle = nullptr; }
+		Task(const Task&) = delete;
+		~Task() { if (handle) handle.destroy(); }
+
+		// starts the task and resumes the awaiter once it finishes
+		bool await_ready() { return false; }
+		coroutine_handle<> await_suspend(coroutine_handle<> awaiter) {
+			handle.promise().continuation = awaiter;
+			return handle;
+		}
+		T await_resume() { return handle.promise().result(); }
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+	return Task<T>(coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+	return Task<void>(coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// coroutine that owns itself and frees its frame when it finishes, used to run spawned tasks
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() { return Detached{coroutine_handle<promise_type>::from_promise(*this)}; }
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { }
+		void unhandled_exception() { }
+	};
+
+	coroutine_handle<promise_type> handle;	//frame of the coroutine
+};
+
+class Scheduler
+{
+	private:
+		Vector<coroutine_handle<>> ready;	//coroutines waiting to be resumed, in order
+		int head;							//index of the next coroutine to resume
+
+		// runs a spawned task to completion, reporting an exception it lets escape
+		static Detached drive(Task<void> task) {
+			try {
+				co_await task;
+			}
+			catch (exception &e) {
+				cerr << "Exception: " << e.what() << endl;
+			}
+		}
+
+	public:
+		// suspends the awaiting coroutine until the scheduler gets back to it
+		struct YieldAwaiter {
+			Scheduler *scheduler;
+
+			bool await_ready() { return false; }
+			void await_suspend(coroutine_handle<> handle) { scheduler->schedule(handle); }
+			void await_resume() { }
+		};
+
+		Scheduler() : head(0) { }
+
+		// queues a coroutine to be resumed
+		void schedule(coroutine_handle<> handle) {
+			ready.push_back(handle);
+		}
+
+		// lets the other coroutines run before continuing
+		YieldAwaiter yield() {
+			return YieldAwaiter{this};
+		}
+
+		// starts a task that nobody awaits
+		void spawn(Task<void> task) {
+			schedule(drive(static_cast<Task<void>&&>(task)).handle);
+		}
+
+		// returns true if no coroutine is waiting
+		bool idle() {
+			return head == ready.size();
+		}
+
+		// resumes waiting coroutines until none is left
+		void run() {
+			while (head < ready.size()) {
+				ready[head++].resume();
+
+				// drops the resumed part of the queue once it is the larger half
+				if (head >= 1024 && 2 * head >= ready.size()) {
+					for (int i = head; i < ready.size(); i++) {
+						ready[i - head] = ready[i];
+					}
+					int remaining = ready.size() - head;
+					while (ready.size() > remaining) {
+						ready.erase(ready.size() - 1);
+					}
+					head = 0;
+				}
+			}
+
+			ready.clear();
+			head = 0;
+		}
+};
+
+#endif
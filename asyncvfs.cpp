@@ -0,0 +1,148 @@
+#include "asyncvfs.hpp"
+
+// closes a walk when the coroutine holding it finishes or is destroyed
+struct WalkGuard {
+    VFS &vfs;
+    Walk &walk;
+
+    ~WalkGuard() {
+        vfs.closeWalk(walk);
+    }
+};
+
+// constructor of the AsyncVFS class
+AsyncVFS::AsyncVFS(VFS &vfs, Scheduler &scheduler) : vfs(vfs), scheduler(scheduler) {
+}
+
+// returns the path of the current folder of a session
+Task<string> AsyncVFS::pwd(Session &session) {
+    vfs.setSession(session);
+    co_return vfs.pwd();
+}
+
+// returns a copy of the children of a folder
+// -- copies rather than views, since the result outlives the suspension of the caller
+Task<Vector<Entry>> AsyncVFS::ls(Session &session, string path) {
+    vfs.setSession(session);
+
+    Vector<Entry> entries;
+    vfs.listEntries(path, entries);
+    co_return entries;
+}
+
+// returns the total size of a folder or file
+Task<uint64_t> AsyncVFS::size(Session &session, string path) {
+    vfs.setSession(session);
+    co_return vfs.size(path);
+}
+
+// changes the current folder of a session
+Task<void> AsyncVFS::cd(Session &session, string path) {
+    vfs.setSession(session);
+    vfs.cd(path);
+    session = vfs.getSession();
+    co_return;
+}
+
+// creates a folder under the current folder of a session
+Task<void> AsyncVFS::mkdir(Session &session, string folder_name) {
+    vfs.setSession(session);
+    vfs.mkdir(folder_name);
+    co_return;
+}
+
+// creates a file under the current folder of a session
+Task<void> AsyncVFS::touch(Session &session, string file_name, uint64_t size) {
+    vfs.setSession(session);
+    vfs.touch(file_name, size);
+    co_return;
+}
+
+// moves a child of the current folder of a session to the bin
+Task<void> AsyncVFS::rm(Session &session, string name) {
+    vfs.setSession(session);
+    vfs.rm(name);
+    co_return;
+}
+
+// moves or renames a file or folder
+Task<void> AsyncVFS::mv(Session &session, string src, string dst) {
+    vfs.setSession(session);
+    vfs.mv(src, dst);
+    co_return;
+}
+
+// copies a file or folder
+Task<void> AsyncVFS::cp(Session &session, string src, string dst, bool recursive, bool cow) {
+    vfs.setSession(session);
+    vfs.cp(src, dst, recursive, cow);
+    co_return;
+}
+
+// reinstates the oldest node of the bin
+Task<void> AsyncVFS::recover() {
+    vfs.recover();
+    co_return;
+}
+
+// returns the path of every node with the given name, yielding between slices of the tree
+// -- nodes changed while the search is suspended may or may not be reported
+Task<Vector<string>> AsyncVFS::find(string name) {
+    Vector<string> paths;
+    Walk walk;
+
+    vfs.openWalk(walk, "/");
+    WalkGuard guard = {vfs, walk};
+
+    while (!vfs.findStep(walk, name, paths, ASYNC_SLICE)) {
+        co_await scheduler.yield();
+    }
+
+    co_return paths;
+}
+
+// writes the tree to a file in the vfs.dat format, yielding between slices of the tree
+// -- changes made while the save is suspended may or may not be included; like VFS::save, only
+//    committed changes are saved, so a transaction open before or during the save stops it
+Task<void> AsyncVFS::save(string filename) {
+    if (vfs.inTransaction()) {
+        throw runtime_error("Cannot save during a transaction");
+    }
+
+    ofstream output(filename, ios::out);
+
+    // checks if file opened successfully
+    if (!output) {
+        throw runtime_error("File failed to open");
+    }
+
+    Walk walk;
+    vfs.openWalk(walk, "/");
+    WalkGuard guard = {vfs, walk};
+
+    while (!vfs.writeStep(walk, output, ASYNC_SLICE)) {
+        co_await scheduler.yield();
+
+        if (vfs.inTransaction()) {
+            throw runtime_error("Cannot save during a transaction");
+        }
+    }
+
+    output.close();
+}
+
+// empties the bin, deleting its nodes in slices
+// -- waits for open walks to finish first, since they may hold nodes of the bin
+Task<void> AsyncVFS::emptybin() {
+    while (vfs.walksOpen()) {
+        co_await scheduler.yield();
+    }
+
+    // the bin is empty from here on; deleting its nodes continues in the background
+    Walk walk;
+    vfs.takeBin(walk);
+
+    while (!vfs.removeStep(walk, ASYNC_SLICE)) {
+        co_await scheduler.yield();
+    }
+}
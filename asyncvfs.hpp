@@ -0,0 +1,44 @@
+#ifndef ASYNCVFS_H
+#define ASYNCVFS_H
+
+#include<string>
+#include "vfs.hpp"
+#include "async.hpp"
+
+using namespace std;
+
+// number of nodes a long operation visits before yielding
+const int ASYNC_SLICE = 256;
+
+// coroutine front end of a vfs for event-driven callers
+// -- every operation returns an awaitable Task with a structured result instead of printing;
+// -- each caller passes its own Session, so requests of different clients can interleave;
+// -- find, save and emptybin yield to the scheduler every ASYNC_SLICE nodes
+class AsyncVFS
+{
+	private:
+		VFS &vfs;					//tree the operations run against
+		Scheduler &scheduler;		//scheduler long operations yield to
+
+	public:
+		AsyncVFS(VFS &vfs, Scheduler &scheduler);
+
+		// short operations complete without suspending
+		Task<string> pwd(Session &session);
+		Task<Vector<Entry>> ls(Session &session, string path);
+		Task<uint64_t> size(Session &session, string path);
+		Task<void> cd(Session &session, string path);
+		Task<void> mkdir(Session &session, string folder_name);
+		Task<void> touch(Session &session, string file_name, uint64_t size);
+		Task<void> rm(Session &session, string name);
+		Task<void> mv(Session &session, string src, string dst);
+		Task<void> cp(Session &session, string src, string dst, bool recursive, bool cow);
+		Task<void> recover();
+
+		// long operations yield while they run
+		Task<Vector<string>> find(string name);
+		Task<void> save(string filename);
+		Task<void> emptybin();
+};
+
+#endif
@@ -0,0 +1,334 @@
+#include<iostream>
+#include<string>
+#include<cstring>
+#include<chrono>
+#include<thread>
+#include<atomic>
+#include<stdlib.h>
+#include<unistd.h>
+#include "vfs.hpp"
+using namespace std;
+
+// ---------------- vfsbench: throughput of file content and cost of watches -------------------------
+// writes the same set of files into a fresh tree with deduplication off and then on, and prints
+// the ingest and read throughput and the bytes of pages each run holds; every other file repeats
+// an earlier one with a few bytes inserted, so shifted copies are deduplicated too. Then times
+// mkdir, touch, mv and rm without a watch, with a watch on an unrelated folder, and with a
+// recursive watch on the root whose events are taken between timed runs, or by another thread as
+// they come
+//
+// usage: vfsbench [-f files] [-s file size] [-d distinct files] [-b write block] [-m mutations]
+
+// settings of a run
+struct Settings {
+	int files;				//files written
+	size_t size;			//bytes of every file
+	int distinct;			//files with unrelated content, the others repeat them
+	size_t block;			//bytes written per call
+	int mutations;			//nodes made, renamed and removed per kind of mutation
+};
+
+// folders the mutations are spread over, so no folder grows large
+const int BENCH_FOLDERS = 64;
+
+// watches a mutation pass runs under
+enum WatchMode {
+	watch_none,				//nothing is watched
+	watch_unrelated,		//a folder outside the mutated ones is watched
+	watch_root,				//the root is watched recursively and the events are taken between runs
+	watch_thread,			//the root is watched recursively and another thread takes the events
+};
+
+// result of one mutation pass, nanoseconds per operation
+struct MutationResult {
+	double mkdir;
+	double touch;
+	double mv;
+	double rm;
+	uint64_t events;		//events the consumer took, merged ones counted
+	uint64_t dropped;		//events the ring had no room for
+};
+
+// result of one pass
+struct Result {
+	double ingest;			//seconds spent writing
+	double read;			//seconds spent reading every file back
+	double copy;			//seconds spent copying every file
+	uint64_t logical;		//bytes written
+	uint64_t physical;		//bytes of pages held by the files
+	ChunkStats chunks;		//counters of the chunk store after the pass
+};
+
+// returns the next value of a xorshift generator
+uint64_t nextRandom(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+// builds the content of every file
+// -- file i repeats file i % distinct; the odd repeats get a few bytes inserted in the middle
+void buildFiles(const Settings &settings, Vector<string> &contents)
+{
+	uint64_t state = 88172645463325252ULL;
+
+	for(int i = 0; i < settings.files; i++)
+	{
+		if(i < settings.distinct)
+		{
+			string content(settings.size, '\0');
+			for(size_t j = 0; j + 8 <= content.size(); j += 8)
+			{
+				uint64_t value = nextRandom(state);
+				memcpy(&content[j], &value, 8);
+			}
+			contents.push_back(content);
+			continue;
+		}
+
+		string content = contents[i % settings.distinct];
+		if(i % 2 == 1)
+		{
+			content.insert(nextRandom(state) % content.size(), "inserted");
+			content.resize(settings.size);
+		}
+		contents.push_back(content);
+	}
+}
+
+// returns the seconds since start
+double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// writes every file into a fresh tree, reads it back and copies it
+Result runPass(const Settings &settings, const Vector<string> &contents, bool dedup)
+{
+	Result result;
+	VFS vfs;
+	vfs.setDedup(dedup);
+	vfs.mkdir("data");
+	vfs.mkdir("copies");
+
+	// writes every file one block at a time, as a stream would
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < contents.size(); i++)
+	{
+		string path = "/data/f" + to_string(i);
+		for(size_t offset = 0; offset < contents[i].size(); offset += settings.block)
+		{
+			vfs.write(path, offset, contents[i].substr(offset, settings.block));
+		}
+	}
+	result.ingest = secondsSince(start);
+
+	// reads every file through its spans, touching every word
+	uint64_t checksum = 0;
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < contents.size(); i++)
+	{
+		ReadCursor cursor = vfs.cat("/data/f" + to_string(i));
+		iovec batch[READ_BATCH];
+		int count;
+		while((count = vfs.nextSpans(cursor, batch, READ_BATCH)) > 0)
+		{
+			for(int j = 0; j < count; j++)
+			{
+				const char *bytes = (const char*)batch[j].iov_base;
+				for(size_t k = 0; k + 8 <= batch[j].iov_len; k += 8)
+				{
+					uint64_t word;
+					memcpy(&word, bytes + k, 8);
+					checksum ^= word;
+				}
+			}
+		}
+	}
+	result.read = secondsSince(start);
+
+	// copies share the content, so they take no pages
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < contents.size(); i++)
+	{
+		vfs.cp("/data/f" + to_string(i), "/copies/f" + to_string(i), false, false);
+	}
+	result.copy = secondsSince(start);
+
+	result.logical = uint64_t(settings.files) * settings.size;
+	result.physical = vfs.physicalSize("/");
+	result.chunks = chunkStore().getStats();
+
+	// keeps the read from being optimized away
+	if(checksum == 1)	cout<<"";
+
+	return result;
+}
+
+// takes every event waiting in a ring and adds it to the counters of a pass
+int takeEvents(WatchRing *ring, MutationResult &result)
+{
+	WatchEvent batch[WATCH_BATCH];
+	int taken = 0;
+	int count;
+	while((count = ring->pop(batch, WATCH_BATCH)) > 0)
+	{
+		for(int i = 0; i < count; i++)
+		{
+			if(batch[i].type == watch_overflow)	result.dropped += batch[i].count;
+			else								result.events += batch[i].count;
+		}
+		taken += count;
+	}
+	return taken;
+}
+
+// runs count mutations of one kind over the bench folders and returns the nanoseconds per operation
+// -- each folder takes its share in turn, so the current folder changes once per folder; with a
+//    ring to drain, its events are taken between runs of WATCH_BATCH mutations, outside the timing
+double timeMutations(VFS &vfs, int count, void (*mutate)(VFS&, int), WatchRing *drain, MutationResult &result)
+{
+	double seconds = 0;
+	for(int k = 0; k < BENCH_FOLDERS; k++)
+	{
+		vfs.cd("/work/d" + to_string(k));
+
+		for(int first = k; first < count; first += WATCH_BATCH * BENCH_FOLDERS)
+		{
+			int last = min(count, first + WATCH_BATCH * BENCH_FOLDERS);
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for(int j = first; j < last; j += BENCH_FOLDERS)	mutate(vfs, j);
+			seconds += secondsSince(start);
+
+			if(drain != nullptr)	takeEvents(drain, result);
+		}
+	}
+	return seconds * 1e9 / count;
+}
+
+// makes, renames and removes nodes in a fresh tree under one kind of watch
+MutationResult runMutations(const Settings &settings, WatchMode mode)
+{
+	MutationResult result = {0, 0, 0, 0, 0, 0};
+	VFS vfs;
+	vfs.mkdir("work");
+	vfs.mkdir("other");
+	vfs.cd("work");
+	for(int k = 0; k < BENCH_FOLDERS; k++)	vfs.mkdir("d" + to_string(k));
+
+	// variables for the ring drained between runs and the thread taking events as they come
+	WatchRing *drain = nullptr;
+	atomic<bool> done(false);
+	thread consumer;
+
+	if(mode == watch_unrelated)	vfs.watch("-r /other");
+	if(mode == watch_root)		drain = vfs.watchRing(vfs.watch("-r /"));
+	if(mode == watch_thread)
+	{
+		WatchRing *ring = vfs.watchRing(vfs.watch("-r /"));
+		consumer = thread([ring, &done, &result]()
+		{
+			while(true)
+			{
+				bool last = done.load();
+				int taken = takeEvents(ring, result);
+				if(taken == 0 && last)	break;
+
+				// an empty ring leaves the core to the mutations
+				if(taken == 0)	this_thread::yield();
+			}
+		});
+	}
+
+	result.mkdir = timeMutations(vfs, settings.mutations, [](VFS &v, int j) { v.mkdir("m" + to_string(j)); }, drain, result);
+	result.touch = timeMutations(vfs, settings.mutations, [](VFS &v, int j) { v.touch("f" + to_string(j), 100); }, drain, result);
+	result.mv = timeMutations(vfs, settings.mutations, [](VFS &v, int j) { v.mv("f" + to_string(j), "g" + to_string(j)); }, drain, result);
+	result.rm = timeMutations(vfs, settings.mutations, [](VFS &v, int j) { v.rm("g" + to_string(j)); }, drain, result);
+
+	done.store(true);
+	if(consumer.joinable())	consumer.join();
+	return result;
+}
+
+// prints one mutation pass
+void printMutations(const string &name, const MutationResult &result, WatchMode mode)
+{
+	cout<<name<<" : "<<setw(7)<<int(result.mkdir)<<' '<<setw(7)<<int(result.touch)<<' '
+		<<setw(7)<<int(result.mv)<<' '<<setw(7)<<int(result.rm);
+	if(mode >= watch_root)	cout<<"   "<<result.events<<" events taken, "<<result.dropped<<" dropped";
+	cout<<endl;
+}
+
+// prints one pass
+void printResult(const string &name, const Result &result, const Settings &settings)
+{
+	double mib = double(settings.files) * settings.size / (1024 * 1024);
+
+	cout<<name<<" : ingest "<<mib / result.ingest<<" MiB/s, read "<<mib / result.read<<" MiB/s, cp "
+		<<result.copy * 1e9 / settings.files<<" ns/file"<<endl
+		<<"             logical "<<result.logical<<" bytes, physical "<<result.physical<<" bytes ("
+		<<100.0 * result.physical / result.logical<<"%)";
+
+	if(result.chunks.lookups > 0)
+	{
+		cout<<", "<<result.chunks.chunks<<" chunks, "
+			<<100.0 * result.chunks.hits / result.chunks.lookups<<"% found stored";
+	}
+	cout<<endl;
+}
+
+int main(int argc, char *argv[])
+{
+	Settings settings = {128, 1 << 20, 16, 64 << 10, 64000};
+
+	// parses the options
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		string option = argv[i];
+		long long value = atoll(argv[i + 1]);
+
+		     if(option=="-f")	settings.files = value;
+		else if(option=="-s")	settings.size = value;
+		else if(option=="-d")	settings.distinct = value;
+		else if(option=="-b")	settings.block = value;
+		else if(option=="-m")	settings.mutations = value;
+	}
+
+	if(settings.files < 1 || settings.size < 16 || settings.distinct < 1 || settings.block < 1 || settings.mutations < 1)
+	{
+		cerr<<"usage: vfsbench [-f files] [-s file size] [-d distinct files] [-b write block] [-m mutations]"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	// a fresh tree is wanted, so the tree never loads a vfs.dat found in the working folder
+	char folder[] = "/tmp/vfsbenchXXXXXX";
+	if(mkdtemp(folder) == nullptr || chdir(folder) != 0)
+	{
+		cerr<<"cannot create a scratch folder"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	Vector<string> contents;
+	buildFiles(settings, contents);
+
+	cout<<"files        : "<<settings.files<<" x "<<settings.size<<" bytes, "<<settings.distinct
+		<<" distinct, written in "<<settings.block<<"-byte blocks"<<endl;
+
+	printResult("dedup off   ", runPass(settings, contents, false), settings);
+	printResult("dedup on    ", runPass(settings, contents, true), settings);
+
+	cout<<"mutations    : "<<settings.mutations<<" of each, ns/op"<<endl
+		<<"                 mkdir   touch      mv      rm"<<endl;
+	// a first pass warms the allocator, so the passes compared start alike
+	runMutations(settings, watch_none);
+	printMutations("no watch    ", runMutations(settings, watch_none), watch_none);
+	printMutations("unrelated   ", runMutations(settings, watch_unrelated), watch_unrelated);
+	printMutations("recursive / ", runMutations(settings, watch_root), watch_root);
+	printMutations("  + consumer", runMutations(settings, watch_thread), watch_thread);
+
+	rmdir(folder);
+	return(EXIT_SUCCESS);
+}
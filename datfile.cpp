@@ -0,0 +1,426 @@
+#include<cstring>
+#include<cstdio>
+#include<stdexcept>
+#include<thread>
+#include<atomic>
+#include<algorithm>
+#include<mutex>
+#include<exception>
+#include<zlib.h>
+#include "datfile.hpp"
+#include "timestamp.hpp"
+
+// first bytes of a compressed file, followed by the version digit
+static const char DAT_MAGIC[3] = {'V', 'F', 'Z'};
+static const char DAT_VERSION = '4';
+
+// returns the zigzag form of a signed change, so small changes either way take few bytes
+static uint64_t zigzag(int64_t delta) {
+    return (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+}
+
+// returns the signed change of a zigzag form
+static int64_t unzigzag(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// appends a number in 7-bit groups, lowest first
+static void putVarint(string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// reads a number written by putVarint from a buffer
+static uint64_t getVarint(const string &in, size_t &pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            break;
+        }
+
+        unsigned char byte = in[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw runtime_error("Invalid compressed file");
+}
+
+// reads a number written by putVarint from a stream
+static uint64_t getVarint(istream &in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            break;
+        }
+
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw runtime_error("Invalid compressed file");
+}
+
+// ---------------- Timestamps of older files -------------------------
+// files before VFZ3 stored the ctime text of a time as seconds counted from its own date and clock
+// fields, which formatTime turns back into the text
+
+static const char* const WEEKDAYS[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* const MONTHS[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// returns the ctime text of a time in seconds, without the line break
+static string formatTime(int64_t seconds) {
+    // splits the time into days and the time of day
+    int64_t days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    int64_t clock = seconds - days * 86400;
+
+    // converts the days back to a date
+    int64_t shifted = days + 719468;
+    int64_t era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    int64_t day_of_era = shifted - era * 146097;
+    int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64_t mp = (5 * day_of_year + 2) / 153;
+    int day = day_of_year - (153 * mp + 2) / 5 + 1;
+    int month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = year_of_era + era * 400 + (month <= 2);
+
+    // 1970-01-01 was a Thursday
+    int weekday = ((days % 7) + 11) % 7;
+
+    char text[64];
+    snprintf(text, sizeof(text), "%s %s%3d %.2d:%.2d:%.2d %lld", WEEKDAYS[weekday], MONTHS[month - 1], day,
+             int(clock / 3600), int(clock / 60 % 60), int(clock % 60), (long long)year);
+    return text;
+}
+
+// ---------------- Writer -------------------------
+
+DatWriter::DatWriter() : prev_time(0) { }
+
+// appends one record to the open block
+void DatWriter::add(const string &path, uint64_t size, NodeType type, uint64_t created, uint64_t modified, uint64_t accessed, const string &target) {
+    // a full block is only closed before a top-level node, so it holds whole top-level subtrees
+    if (block.size() >= DAT_BLOCK_BYTES && path.size() > 1 && path.find('/', 1) == string::npos) {
+        closeBlock();
+    }
+
+    // the path is stored as the length it shares with the previous one and the rest
+    size_t shared = 0;
+    while (shared < path.size() && shared < prev_path.size() && path[shared] == prev_path[shared]) {
+        shared++;
+    }
+
+    putVarint(block, shared);
+    putVarint(block, path.size() - shared);
+    block.append(path, shared, string::npos);
+    putVarint(block, size);
+    block += char(type);
+
+    // the creation time is stored as the change from the previous one, the other times as the change
+    // from the time before them, so nodes made together cost a byte per time
+    putVarint(block, zigzag(created - prev_time));
+    putVarint(block, zigzag(modified - created));
+    putVarint(block, zigzag(accessed - modified));
+    prev_time = created;
+
+    // a symbolic link is followed by the path it holds
+    if (type == symbolic_link) {
+        putVarint(block, target.size());
+        block += target;
+    }
+
+    prev_path = path;
+}
+
+// moves the open block to the finished ones, the next block starts from an empty path and time
+void DatWriter::closeBlock() {
+    if (block.empty()) {
+        return;
+    }
+
+    blocks.push_back(block);
+    block.clear();
+    prev_path.clear();
+    prev_time = 0;
+}
+
+// compresses every block, one thread per core, and writes the header and the blocks
+void DatWriter::finish(ostream &out) {
+    closeBlock();
+
+    // one slot per block, so the threads never share one
+    Vector<string> compressed;
+    for (int i = 0; i < blocks.size(); i++) {
+        compressed.push_back("");
+    }
+
+    parallelBlocks(blocks.size(), [this, &compressed](int i) {
+        uLongf length = compressBound(blocks[i].size());
+        compressed[i].resize(length);
+
+        if (compress2((Bytef*)&compressed[i][0], &length, (const Bytef*)blocks[i].data(), blocks[i].size(), DAT_LEVEL) != Z_OK) {
+            throw runtime_error("Failed to compress the file");
+        }
+        compressed[i].resize(length);
+    });
+
+    // the table of contents locates every block, so a reader can take any of them on its own
+    string header(DAT_MAGIC, sizeof(DAT_MAGIC));
+    header += DAT_VERSION;
+    putVarint(header, blocks.size());
+
+    uint64_t offset = 0;
+    for (int i = 0; i < blocks.size(); i++) {
+        putVarint(header, offset);
+        putVarint(header, blocks[i].size());
+        putVarint(header, compressed[i].size());
+        offset += compressed[i].size();
+    }
+
+    out.write(header.data(), header.size());
+    for (int i = 0; i < compressed.size(); i++) {
+        out.write(compressed[i].data(), compressed[i].size());
+    }
+
+    blocks.clear();
+}
+
+// ---------------- Reader -------------------------
+
+DatReader::DatReader() : version(0) {
+    openBlock(0, cursor);
+}
+
+// reads the table of contents and the compressed blocks, without decompressing them
+void DatReader::open(istream &in) {
+    char magic[sizeof(DAT_MAGIC) + 1];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, DAT_MAGIC, sizeof(DAT_MAGIC)) != 0) {
+        throw runtime_error("Invalid compressed file");
+    }
+
+    version = magic[sizeof(DAT_MAGIC)] - '0';
+    if (version < 1 || version > DAT_VERSION - '0') {
+        throw runtime_error("Invalid compressed file");
+    }
+
+    // the first version has no offsets and may cut a subtree between blocks
+    bool first_version = (version == 1);
+
+    // reads the table of contents
+    int count = getVarint(in);
+    uint64_t total = 0;
+
+    for (int i = 0; i < count; i++) {
+        offsets.push_back(first_version ? total : getVarint(in));
+        raw_sizes.push_back(getVarint(in));
+        lengths.push_back(getVarint(in));
+        blocks.push_back("");
+
+        total = max(total, offsets[i] + lengths[i]);
+    }
+
+    // reads the blocks in one go
+    data.resize(total);
+    if (total > 0 && !in.read(&data[0], total)) {
+        throw runtime_error("Invalid compressed file");
+    }
+
+    openBlock(0, cursor);
+}
+
+// returns the number of blocks
+int DatReader::blockCount() {
+    return blocks.size();
+}
+
+// returns true if every block holds whole top-level subtrees
+bool DatReader::splitsSubtrees() {
+    return version >= 2;
+}
+
+// decompresses one block
+// -- every block has its own slot, so different blocks may be decoded on different threads
+void DatReader::decodeBlock(int index) {
+    uLongf length = raw_sizes[index];
+    blocks[index].resize(length);
+
+    if (uncompress((Bytef*)&blocks[index][0], &length, (const Bytef*)data.data() + offsets[index], lengths[index]) != Z_OK || length != raw_sizes[index]) {
+        throw runtime_error("Invalid compressed file");
+    }
+}
+
+// decompresses every block, one thread per core
+void DatReader::decodeAll() {
+    parallelBlocks(blocks.size(), [this](int i) {
+        decodeBlock(i);
+    });
+}
+
+// frees the decompressed bytes of a block that was read
+void DatReader::dropBlock(int index) {
+    string().swap(blocks[index]);
+}
+
+// starts reading a decoded block, which starts from an empty path and time
+void DatReader::openBlock(int index, DatCursor &at) {
+    at.block = index;
+    at.pos = 0;
+    at.path.clear();
+    at.prev_time = 0;
+    at.prev_seconds = 0;
+}
+
+// decodes the next record of a block
+bool DatReader::next(DatCursor &at, DatRecord &record) {
+    if (at.block >= blocks.size() || at.pos == blocks[at.block].size()) {
+        return false;
+    }
+
+    const string &in = blocks[at.block];
+    size_t &pos = at.pos;
+
+    // rebuilds the path from the part it shares with the previous one
+    uint64_t shared = getVarint(in, pos);
+    uint64_t length = getVarint(in, pos);
+    if (shared > at.path.size() || length > in.size() - pos) {
+        throw runtime_error("Invalid compressed file");
+    }
+    at.path.resize(shared);
+    at.path.append(in, pos, length);
+    pos += length;
+
+    record.path = at.path;
+    record.size = getVarint(in, pos);
+    if (pos >= in.size()) {
+        throw runtime_error("Invalid compressed file");
+    }
+    record.type = datType(in[pos++]);
+    record.target.clear();
+
+    if (version >= 3) {
+        record.time_created = at.prev_time + unzigzag(getVarint(in, pos));
+        record.time_modified = record.time_created + unzigzag(getVarint(in, pos));
+        record.time_accessed = record.time_modified + unzigzag(getVarint(in, pos));
+        at.prev_time = record.time_created;
+
+        if (record.type == symbolic_link) {
+            length = getVarint(in, pos);
+            if (length > in.size() - pos) {
+                throw runtime_error("Invalid compressed file");
+            }
+            record.target.assign(in, pos, length);
+            pos += length;
+        }
+        return true;
+    }
+
+    // older files hold one ctime time, as a change from the previous one or a text stored as is
+    uint64_t code = getVarint(in, pos);
+    if (code & 1) {
+        length = code >> 1;
+        if (length > in.size() - pos) {
+            throw runtime_error("Invalid compressed file");
+        }
+        parseTimes(in.substr(pos, length), record.time_created, record.time_modified, record.time_accessed);
+        pos += length;
+        return true;
+    }
+
+    // an unchanged time reuses the time of the previous record
+    int64_t delta = unzigzag(code >> 1);
+    if (delta != 0 || at.prev_time == 0) {
+        at.prev_seconds += delta;
+        parseTimestamp(formatTime(at.prev_seconds), at.prev_time);
+    }
+    record.time_created = record.time_modified = record.time_accessed = at.prev_time;
+
+    return true;
+}
+
+// decodes the next record of the file, moving through the blocks in order
+bool DatReader::next(DatRecord &record) {
+    while (!next(cursor, record)) {
+        if (cursor.block + 1 >= blocks.size()) {
+            return false;
+        }
+        openBlock(cursor.block + 1, cursor);
+    }
+    return true;
+}
+
+// runs work on every index below count, spread over one thread per core
+// -- the threads take the next index as they finish one, so uneven blocks still keep every core busy
+void parallelBlocks(int count, const function<void(int)> &work) {
+    atomic<int> next_index(0);
+    exception_ptr error;
+    mutex error_lock;
+
+    auto worker = [&]() {
+        for (int i = next_index++; i < count; i = next_index++) {
+            try {
+                work(i);
+            }
+            catch (...) {
+                lock_guard<mutex> guard(error_lock);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        }
+    };
+
+    // the calling thread is one of the workers
+    int workers = max(1, min(int(thread::hardware_concurrency()), count));
+    Vector<thread*> threads;
+    for (int t = 1; t < workers; t++) {
+        threads.push_back(new thread(worker));
+    }
+    worker();
+
+    for (int t = 0; t < threads.size(); t++) {
+        threads[t]->join();
+        delete threads[t];
+    }
+
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+// returns true if the stream holds a compressed vfs.dat, without consuming anything
+bool isCompressedDat(istream &in) {
+    streampos start = in.tellg();
+
+    char magic[sizeof(DAT_MAGIC)];
+    bool found = in.read(magic, sizeof(magic)) && memcmp(magic, DAT_MAGIC, sizeof(magic)) == 0;
+
+    in.clear();
+    in.seekg(start);
+    return found;
+}
+
+// returns the type of a node from its number in a vfs.dat file
+// -- any other number is a folder, as in files written before symbolic links
+NodeType datType(int code) {
+    if (code == file) {
+        return file;
+    }
+
+    return (code == symbolic_link) ? symbolic_link : folder;
+}
+
+// returns the path after the three times at the end of a text vfs.dat line
+string datTarget(const string &times) {
+    size_t comma = times.find(',');
+    comma = (comma == string::npos) ? comma : times.find(',', comma + 1);
+    comma = (comma == string::npos) ? comma : times.find(',', comma + 1);
+
+    return (comma == string::npos) ? "" : times.substr(comma + 1);
+}
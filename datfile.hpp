@@ -0,0 +1,107 @@
+#ifndef DATFILE_H
+#define DATFILE_H
+
+#include<iostream>
+#include<string>
+#include<cstdint>
+#include<functional>
+#include "node.hpp"
+#include "vector.hpp"
+
+using namespace std;
+
+// ---------------- Compressed vfs.dat format -------------------------
+// the nodes are written in the preorder of the text format, but every path only stores what differs
+// from the previous one (front coding), every creation time is stored as the change from the previous
+// one and the modification and access times as the change from the time before them, and a symbolic
+// link is followed by the path it holds. The records are cut into blocks that each start from an empty path and time, so every block
+// is compressed with zlib on its own, and the blocks are compressed and decompressed in parallel.
+// A block is only cut before a top-level node, so every block holds whole top-level subtrees (the
+// first one also holds the root) and can be turned into nodes on its own thread.
+//
+// layout: "VFZ4", number of blocks, then a table of contents giving for every block its byte offset
+// from the end of the table, raw size and compressed size, then the compressed blocks one after
+// another; every number is a varint. "VFZ3" files have no symbolic links, "VFZ2" files also hold ctime
+// times in seconds and "VFZ1" files also have no offsets and blocks cut anywhere.
+
+// raw bytes of records after which a new block is started
+#define DAT_BLOCK_BYTES (1 << 20)
+
+// zlib level of the blocks: the fastest one, since the records are already front coded
+#define DAT_LEVEL 1
+
+// one node of a vfs.dat file, in preorder
+struct DatRecord {
+	string path;			//path of the node
+	uint64_t size;			//size of the node
+	NodeType type;			//type of the node
+	uint64_t time_created;	//creation time of the node, in nanoseconds
+	uint64_t time_modified;	//modification time of the node, in nanoseconds
+	uint64_t time_accessed;	//access time of the node, in nanoseconds
+	string target;			//path held by a symbolic link, empty for other nodes
+};
+
+// encodes records into blocks and writes them compressed
+class DatWriter
+{
+	private:
+		Vector<string> blocks;	//encoded records of every finished block
+		string block;			//encoded records of the open block
+		string prev_path;		//path of the previous record of the open block
+		uint64_t prev_time;		//creation time of the previous record of the open block
+
+		void closeBlock();		//moves the open block to the finished ones
+	public:
+		DatWriter();
+		void add(const string &path, uint64_t size, NodeType type, uint64_t created, uint64_t modified, uint64_t accessed, const string &target); //appends one record
+		void finish(ostream &out);	//compresses the blocks in parallel and writes the file
+};
+
+// position of a reader inside one block
+struct DatCursor {
+	int block;				//block being read
+	size_t pos;				//position of the next record in the block
+	string path;			//path of the previous record
+	uint64_t prev_time;		//creation time of the previous record
+	int64_t prev_seconds;	//ctime time of the previous record in files before VFZ3, in seconds
+};
+
+// reads a compressed file; blocks are decompressed and read on their own, so threads can share a reader
+class DatReader
+{
+	private:
+		string data;				//compressed blocks, one after another
+		Vector<uint64_t> offsets;	//offset of every block in data
+		Vector<uint64_t> lengths;	//compressed size of every block
+		Vector<uint64_t> raw_sizes;	//decompressed size of every block
+		Vector<string> blocks;		//decompressed bytes of every block, empty until decoded
+		int version;				//format version of the file, from its first bytes
+		DatCursor cursor;			//position of next(record)
+	public:
+		DatReader();
+		void open(istream &in);					//reads the table of contents and the compressed blocks
+		int blockCount();						//returns the number of blocks
+		bool splitsSubtrees();					//returns true if every block holds whole top-level subtrees
+		void decodeBlock(int index);			//decompresses one block, different blocks may be decoded at once
+		void decodeAll();						//decompresses every block, one thread per core
+		void dropBlock(int index);				//frees the decompressed bytes of a block
+		void openBlock(int index, DatCursor &at);	//starts reading a decoded block
+		bool next(DatCursor &at, DatRecord &record);	//reads the next record of a block, returns false at its end
+		bool next(DatRecord &record);			//reads the next record of the file once decodeAll ran, false at the end
+};
+
+// runs work on every index below count, spread over one thread per core
+// -- the first exception thrown by work is rethrown once every thread has finished
+void parallelBlocks(int count, const function<void(int)> &work);
+
+// returns true if the stream holds a compressed vfs.dat, without consuming anything
+bool isCompressedDat(istream &in);
+
+// returns the type of a node from its number in a vfs.dat file
+NodeType datType(int code);
+
+// returns the path a symbolic link holds from the end of a text vfs.dat line, the part after the types
+// -- the path follows the three times, empty if there is none
+string datTarget(const string &times);
+
+#endif
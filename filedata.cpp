@@ -0,0 +1,582 @@
+#include<cstring>
+#include<cstdlib>
+#include<new>
+#include<algorithm>
+#include<string>
+#include "filedata.hpp"
+
+// zeros that reads of holes point into
+static const char zero_bytes[EXTENT_PAGES * PAGE_BYTES] = {};
+
+// random values the rolling hash adds for each byte value, the same in every run
+struct GearTable {
+    uint64_t values[256];
+
+    GearTable() {
+        // splitmix64, seeded with a fixed constant
+        uint64_t state = 0x9e3779b97f4a7c15ULL;
+        for (int i = 0; i < 256; i++) {
+            uint64_t value = (state += 0x9e3779b97f4a7c15ULL);
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+            values[i] = value ^ (value >> 31);
+        }
+    }
+};
+
+// constructor of the page pool
+PagePool::PagePool() : next(nullptr), left(0) { }
+
+// returns a run of pages, reusing a freed run of the same length first
+char* PagePool::allocate(int pages) {
+    lock_guard<mutex> guard(lock);
+
+    if (!free_runs[pages].empty()) {
+        char* run = free_runs[pages].back();
+        free_runs[pages].erase(free_runs[pages].size() - 1);
+        return run;
+    }
+
+    // starts a new slab once the newest one is used up
+    // -- its unused pages are kept as a freed run
+    if (left < pages) {
+        if (left > 0) {
+            free_runs[left].push_back(next);
+        }
+
+        next = (char*)aligned_alloc(PAGE_BYTES, size_t(SLAB_PAGES) * PAGE_BYTES);
+        if (next == nullptr) {
+            throw bad_alloc();
+        }
+
+        slabs.push_back(next);
+        left = SLAB_PAGES;
+    }
+
+    char* run = next;
+    next += size_t(pages) * PAGE_BYTES;
+    left -= pages;
+    return run;
+}
+
+// takes back a run of pages
+void PagePool::release(char *run, int pages) {
+    lock_guard<mutex> guard(lock);
+    free_runs[pages].push_back(run);
+}
+
+// returns the pool every file takes its pages from
+// -- the pool is never deleted, so trees deleted while the program exits can still return pages
+PagePool& pagePool() {
+    static PagePool* pool = new PagePool();
+    return *pool;
+}
+
+// returns a new run of pages read by one extent, zeroed if asked
+static ExtentRun* newRun(int pages, bool zeroed) {
+    ExtentRun* run = new ExtentRun;
+    run->refs = 1;
+    run->pages = pages;
+    run->data = pagePool().allocate(pages);
+    run->stored = false;
+
+    if (zeroed) {
+        memset(run->data, 0, size_t(pages) * PAGE_BYTES);
+    }
+    return run;
+}
+
+// stops an extent from reading a run, freeing it once no extent does
+static void releaseRun(ExtentRun *run) {
+    if (run->stored) {
+        chunkStore().release(run);
+    }
+    else if (--run->refs == 0) {
+        pagePool().release(run->data, run->pages);
+        delete run;
+    }
+}
+
+// returns the offset just past the bytes of an extent
+static uint64_t extentEnd(const Extent &extent) {
+    return extent.offset + extent.length;
+}
+
+// ---------------- Chunk store -------------------------
+
+// constructor of the chunk store
+ChunkStore::ChunkStore() : stats({0, 0, 0, 0}) { }
+
+// returns the stored chunk holding the bytes, with one more reference, adding it if it is new
+// -- the digest is computed before taking the lock, so files hashing on several threads do not wait
+ExtentRun* ChunkStore::intern(const char *data, size_t length) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)data, length, digest);
+
+    // the first bytes of the digest order the store
+    uint64_t key;
+    memcpy(&key, digest, sizeof(key));
+
+    lock_guard<mutex> guard(lock);
+    stats.lookups++;
+
+    // checks the whole digest of every chunk sharing the key
+    for (SkipList<uint64_t, ExtentRun*>::Entry* entry = chunks.lowerBound(key); entry != nullptr && entry->key == key; entry = entry->next[0]) {
+        if (memcmp(entry->value->digest, digest, SHA256_DIGEST_LENGTH) == 0) {
+            entry->value->refs++;
+            stats.hits++;
+            return entry->value;
+        }
+    }
+
+    // stores a copy of the bytes
+    ExtentRun* run = newRun((length + PAGE_BYTES - 1) / PAGE_BYTES, false);
+    memcpy(run->data, data, length);
+    memcpy(run->digest, digest, SHA256_DIGEST_LENGTH);
+    run->stored = true;
+
+    chunks.insert(key, run);
+    stats.chunks++;
+    stats.bytes += uint64_t(run->pages) * PAGE_BYTES;
+    return run;
+}
+
+// drops one reference to a stored chunk, taking it out of the store after the last one
+void ChunkStore::release(ExtentRun *run) {
+    lock_guard<mutex> guard(lock);
+
+    if (--run->refs > 0) {
+        return;
+    }
+
+    uint64_t key;
+    memcpy(&key, run->digest, sizeof(key));
+    chunks.erase(key, run);
+    stats.chunks--;
+    stats.bytes -= uint64_t(run->pages) * PAGE_BYTES;
+
+    pagePool().release(run->data, run->pages);
+    delete run;
+}
+
+// returns the counters of the store
+ChunkStats ChunkStore::getStats() {
+    lock_guard<mutex> guard(lock);
+    return stats;
+}
+
+// returns the store every file keeps its chunks in
+// -- never deleted, like the page pool
+ChunkStore& chunkStore() {
+    static ChunkStore* store = new ChunkStore();
+    return *store;
+}
+
+// returns the length of the first chunk of data
+// -- a gear hash adds a random value per byte and shifts, so its top bits depend on the last 64
+//    bytes; the chunk ends after the first byte past CHUNK_MIN where they are all zero
+size_t chunkLength(const char *data, size_t length) {
+    static const GearTable gear;
+
+    if (length <= CHUNK_MIN) {
+        return length;
+    }
+
+    size_t limit = min(length, size_t(CHUNK_MAX));
+    uint64_t hash = 0;
+
+    for (size_t i = CHUNK_MIN; i < limit; i++) {
+        hash = (hash << 1) + gear.values[(unsigned char)data[i]];
+        if ((hash >> (64 - CHUNK_BITS)) == 0) {
+            return i + 1;
+        }
+    }
+
+    return limit;
+}
+
+// returns the bytes of pages held by the distinct runs of a list, which it sorts
+uint64_t distinctBytes(Vector<const ExtentRun*> &runs) {
+    uint64_t total = 0;
+
+    if (runs.size() > 1) {
+        sort(&runs[0], &runs[0] + runs.size());
+    }
+
+    for (int i = 0; i < runs.size(); i++) {
+        if (i == 0 || runs[i] != runs[i - 1]) {
+            total += uint64_t(runs[i]->pages) * PAGE_BYTES;
+        }
+    }
+
+    return total;
+}
+
+// ---------------- File content -------------------------
+
+// constructor of an empty file
+FileData::FileData() : stored(0), paged(false) {
+    memset(bytes, 0, INLINE_BYTES);
+}
+
+// copies a file, sharing its list of extents
+FileData::FileData(const FileData &other) : stored(other.stored), paged(other.paged) {
+    if (paged) {
+        extents = other.extents;
+        extents->refs++;
+    }
+    else {
+        memcpy(bytes, other.bytes, INLINE_BYTES);
+    }
+}
+
+// replaces the content with a copy of other, sharing its list of extents
+FileData& FileData::operator=(const FileData &other) {
+    if (this != &other) {
+        // takes the copy first, so sharing the list with other does not free it
+        FileData copy(other);
+        clear();
+
+        stored = copy.stored;
+        paged = copy.paged;
+        if (paged) {
+            // the copy hands its reference over
+            extents = copy.extents;
+            copy.paged = false;
+        }
+        else {
+            memcpy(bytes, copy.bytes, INLINE_BYTES);
+        }
+    }
+    return *this;
+}
+
+// destructor of a file's content
+FileData::~FileData() {
+    clear();
+}
+
+// drops the list of extents, releasing every run once no file shares it, and leaves an empty small file
+void FileData::clear() {
+    if (paged) {
+        if (--extents->refs == 0) {
+            for (int i = 0; i < extents->items.size(); i++) {
+                releaseRun(extents->items[i].run);
+            }
+            delete extents;
+        }
+        paged = false;
+    }
+
+    stored = 0;
+    memset(bytes, 0, INLINE_BYTES);
+}
+
+// returns the index of the first extent ending past offset, the number of extents if none does
+// -- the extents do not overlap, so their ends are in order too
+int FileData::findExtent(uint64_t offset) const {
+    const Vector<Extent>& list = extents->items;
+    int low = 0;
+    int high = list.size();
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (extentEnd(list[mid]) <= offset) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+// gives the file a list of extents of its own if a copy still shares it
+void FileData::ownList() {
+    if (extents->refs == 1) {
+        return;
+    }
+
+    // the new list reads the same runs
+    ExtentList* copy = new ExtentList;
+    copy->refs = 1;
+    copy->items = extents->items;
+    for (int i = 0; i < copy->items.size(); i++) {
+        copy->items[i].run->refs++;
+    }
+
+    extents->refs--;
+    extents = copy;
+}
+
+// gives an extent a run of its own if another extent still reads its run or the run is a stored chunk
+void FileData::ownRun(Extent &extent) {
+    if (!extent.run->stored && extent.run->refs == 1) {
+        return;
+    }
+
+    ExtentRun* copy = newRun(extent.run->pages, false);
+    memcpy(copy->data, extent.run->data, extent.length);
+
+    releaseRun(extent.run);
+    extent.run = copy;
+}
+
+// adds a zeroed extent at index starting at the page of offset, or at the end of the extent before,
+// and covering as much of the hole up to end as one run can
+// -- a file growing at its end gets runs twice as long as the one before, so appends stay in few extents
+void FileData::addExtent(int index, uint64_t offset, uint64_t end) {
+    Vector<Extent>& list = extents->items;
+
+    // variables for the first byte of the extent and the start of the next one
+    uint64_t first = offset / PAGE_BYTES * PAGE_BYTES;
+    if (index > 0) {
+        first = max(first, extentEnd(list[index - 1]));
+    }
+    uint64_t limit = (index < list.size()) ? list[index].offset : UINT64_MAX;
+
+    uint64_t pages = (min(end, limit) - first + PAGE_BYTES - 1) / PAGE_BYTES;
+    if (index > 0 && extentEnd(list[index - 1]) == first && !list[index - 1].run->stored) {
+        pages = max(pages, uint64_t(list[index - 1].run->pages) * 2);
+    }
+    pages = min(pages, uint64_t(EXTENT_PAGES));
+
+    Extent extent = {first, min(pages * PAGE_BYTES, limit - first), newRun(pages, true)};
+    if (index < list.size()) {
+        list.insert(index, extent);
+    }
+    else {
+        list.push_back(extent);
+    }
+}
+
+// fills the hole at offset with the chunks of length bytes of data and returns the index after them
+// -- a chunk that ended where the hole starts is cut again together with the new bytes, so bytes
+//    appended in pieces are chunked as if they were written at once
+int FileData::addChunks(int index, uint64_t offset, const char *data, uint64_t length) {
+    Vector<Extent>& list = extents->items;
+
+    if (index > 0 && list[index - 1].run->stored && extentEnd(list[index - 1]) == offset && list[index - 1].length < CHUNK_MAX) {
+        // variables for the last chunk and the bytes it could grow by
+        Extent& last = list[index - 1];
+        string joined(last.run->data, last.length);
+        joined.append(data, min(length, uint64_t(CHUNK_MAX)));
+
+        size_t cut = chunkLength(joined.data(), joined.size());
+        if (cut > last.length) {
+            ExtentRun* chunk = chunkStore().intern(joined.data(), cut);
+            size_t taken = cut - last.length;
+
+            releaseRun(last.run);
+            last.run = chunk;
+            last.length = cut;
+
+            offset += taken;
+            data += taken;
+            length -= taken;
+        }
+    }
+
+    while (length > 0) {
+        size_t cut = chunkLength(data, length);
+
+        Extent extent = {offset, cut, chunkStore().intern(data, cut)};
+        if (index < list.size()) {
+            list.insert(index, extent);
+        }
+        else {
+            list.push_back(extent);
+        }
+
+        index++;
+        offset += cut;
+        data += cut;
+        length -= cut;
+    }
+
+    return index;
+}
+
+// writes length bytes at offset into the extents, filling the holes they land in
+void FileData::writeExtents(uint64_t offset, const char *data, size_t length, bool dedup) {
+    ownList();
+
+    Vector<Extent>& list = extents->items;
+    uint64_t end = offset + length;
+    int index = findExtent(offset);
+    uint64_t pos = offset;
+
+    while (pos < end) {
+        // a hole is filled with chunks, or gets pages which the next pass writes into
+        if (index == list.size() || list[index].offset > pos) {
+            if (dedup) {
+                uint64_t stop = (index < list.size()) ? min(end, list[index].offset) : end;
+                index = addChunks(index, pos, data + (pos - offset), stop - pos);
+                pos = stop;
+            }
+            else {
+                addExtent(index, pos, end);
+            }
+            continue;
+        }
+
+        // bytes written over an extent go into a run of its own
+        Extent& extent = list[index];
+        ownRun(extent);
+
+        uint64_t stop = min(end, extentEnd(extent));
+        memcpy(extent.run->data + (pos - extent.offset), data + (pos - offset), stop - pos);
+
+        pos = stop;
+        index++;
+    }
+}
+
+// moves the bytes of a small file into extents
+void FileData::toPages(bool dedup) {
+    // variables for the bytes kept in the node, which the union is about to reuse
+    char saved[INLINE_BYTES];
+    int length = stored;
+    memcpy(saved, bytes, INLINE_BYTES);
+
+    extents = new ExtentList;
+    extents->refs = 1;
+    paged = true;
+    stored = 0;
+
+    if (length > 0) {
+        writeExtents(0, saved, length, dedup);
+    }
+}
+
+// moves the first size bytes of a file back into the node and drops its extents
+void FileData::toInline(uint64_t size) {
+    char saved[INLINE_BYTES] = {};
+
+    // gathers the bytes, holes included
+    iovec spans[INLINE_BYTES];
+    uint64_t offset = 0;
+    int count = read(offset, size, spans, INLINE_BYTES);
+
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(saved + pos, spans[i].iov_base, spans[i].iov_len);
+        pos += spans[i].iov_len;
+    }
+
+    clear();
+    memcpy(bytes, saved, INLINE_BYTES);
+    stored = size;
+}
+
+// writes length bytes at offset, filling the holes they land in with chunks, or with pages without dedup
+void FileData::write(uint64_t offset, const char *data, size_t length, bool dedup) {
+    if (length == 0) {
+        return;
+    }
+
+    uint64_t end = offset + length;
+
+    // a small file stays in the node while the bytes fit
+    if (!paged && end <= INLINE_BYTES) {
+        memcpy(bytes + offset, data, length);
+        stored = max(uint64_t(stored), end);
+        return;
+    }
+
+    if (!paged) {
+        toPages(dedup);
+    }
+
+    writeExtents(offset, data, length, dedup);
+}
+
+// drops every byte at or past size, releasing the extents that lie past it
+// -- the extent holding the new end is shortened, so growing the file again reads a hole
+void FileData::cut(uint64_t size) {
+    if (!paged) {
+        if (size < stored) {
+            memset(bytes + size, 0, stored - size);
+            stored = size;
+        }
+        return;
+    }
+
+    // a file cut down to a few bytes goes back into the node
+    if (size <= INLINE_BYTES) {
+        toInline(size);
+        return;
+    }
+
+    ownList();
+
+    Vector<Extent>& list = extents->items;
+    while (!list.empty() && list.back().offset >= size) {
+        releaseRun(list.back().run);
+        list.erase(list.size() - 1);
+    }
+
+    if (!list.empty() && extentEnd(list.back()) > size) {
+        list[list.size() - 1].length = size - list.back().offset;
+    }
+}
+
+// points up to max spans at the bytes from offset up to end and moves offset past them
+// -- holes point into a shared page of zeros, so nothing is copied; returns the number of spans
+int FileData::read(uint64_t &offset, uint64_t end, iovec *spans, int max) const {
+    int count = 0;
+
+    while (offset < end && count < max) {
+        // variables for the bytes of the next span
+        const char* base;
+        uint64_t stop;
+
+        if (!paged) {
+            if (offset < stored) {
+                base = bytes + offset;
+                stop = min(end, uint64_t(stored));
+            }
+            else {
+                base = zero_bytes;
+                stop = min(end, offset + sizeof(zero_bytes));
+            }
+        }
+        else {
+            int index = findExtent(offset);
+            const Vector<Extent>& list = extents->items;
+
+            if (index < list.size() && list[index].offset <= offset) {
+                base = list[index].run->data + (offset - list[index].offset);
+                stop = min(end, extentEnd(list[index]));
+            }
+            else {
+                base = zero_bytes;
+                stop = min(min(end, offset + sizeof(zero_bytes)), (index < list.size()) ? list[index].offset : end);
+            }
+        }
+
+        spans[count].iov_base = (void*)base;
+        spans[count].iov_len = stop - offset;
+        count++;
+        offset = stop;
+    }
+
+    return count;
+}
+
+// returns the bytes of the pages the file reads, each run counted once, 0 for a small file kept in the node
+uint64_t FileData::allocated() const {
+    Vector<const ExtentRun*> runs;
+    addRuns(runs);
+    return distinctBytes(runs);
+}
+
+// appends every run the file reads, once per extent
+void FileData::addRuns(Vector<const ExtentRun*> &runs) const {
+    if (paged) {
+        for (int i = 0; i < extents->items.size(); i++) {
+            runs.push_back(extents->items[i].run);
+        }
+    }
+}
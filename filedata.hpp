@@ -0,0 +1,157 @@
+#ifndef FILEDATA_H
+#define FILEDATA_H
+
+#include<cstdint>
+#include<cstddef>
+#include<mutex>
+#include<atomic>
+#include<sys/uio.h>
+#include<openssl/sha.h>
+#include "vector.hpp"
+#include "skiplist.hpp"
+
+using namespace std;
+
+// ---------------- File content -------------------------
+// the content of a small file is kept in the node itself; a larger file keeps its bytes in extents,
+// ranges of the file each read from a run of pages, ordered by their offset in the file. A range no
+// extent covers is a hole and reads as zeros, so a file can be far larger than the pages it holds.
+//
+// with deduplication on, written bytes are cut into chunks where a rolling hash of the last bytes
+// hits a pattern, so the cuts follow the content rather than the offsets and the same bytes give the
+// same chunks wherever they sit in a file. Every chunk is looked up by its SHA-256 in the chunk
+// store and identical chunks share one run. Without it, written bytes go into runs of whole pages.
+//
+// runs are shared by reference count and a run in the chunk store is never written again, so a
+// write into a shared or stored run copies it first. Copies of a file share its list of extents
+// until one of them changes it, so copying a file is constant time.
+
+// bytes in a page, the unit runs are allocated in
+const int PAGE_BYTES = 4096;
+
+// most pages held by one run
+const int EXTENT_PAGES = 16;
+
+// pages taken from the system at once by the page pool
+const int SLAB_PAGES = 256;
+
+// files whose bytes all lie in the first INLINE_BYTES are kept in the node
+const int INLINE_BYTES = 30;
+
+// largest size a file can be written or truncated to
+const uint64_t MAX_FILE_BYTES = 1ULL << 48;
+
+// smallest chunk cut by the rolling hash; the hash is not checked before it
+const int CHUNK_MIN = 2048;
+
+// bits of the rolling hash that have to be zero to cut, giving 8 KiB past the minimum on average
+const int CHUNK_BITS = 13;
+
+// largest chunk, one run
+const int CHUNK_MAX = EXTENT_PAGES * PAGE_BYTES;
+
+// hands out runs of pages carved from large slabs
+// -- a freed run is kept for the next run of the same length; slabs are never returned
+class PagePool
+{
+	private:
+		Vector<char*> slabs;					//slabs taken from the system
+		Vector<char*> free_runs[EXTENT_PAGES + 1];	//freed runs by number of pages
+		char *next;								//first unused page of the newest slab
+		int left;								//unused pages of the newest slab
+		mutex lock;								//files of different trees may change at once
+	public:
+		PagePool();
+		char* allocate(int pages);				//returns a run of pages, not zeroed
+		void release(char *run, int pages);		//takes back a run of pages
+};
+
+// returns the pool every file takes its pages from
+PagePool& pagePool();
+
+// pages holding part of one or more files
+struct ExtentRun {
+	atomic<int> refs;		//extents reading the run
+	int pages;				//pages in the run
+	char *data;				//first byte of the run
+	bool stored;			//the run is a chunk of the chunk store and is never written again
+	unsigned char digest[SHA256_DIGEST_LENGTH];	//SHA-256 of the chunk, if stored
+};
+
+// one extent of a file
+struct Extent {
+	uint64_t offset;		//offset in the file of the first byte
+	uint64_t length;		//bytes of the run the file reads
+	ExtentRun *run;			//pages holding the bytes
+};
+
+// extents of a file, shared by its copies until one of them changes
+struct ExtentList {
+	int refs;				//files sharing the list
+	Vector<Extent> items;	//extents by offset
+};
+
+// counters of the chunk store
+struct ChunkStats {
+	uint64_t chunks;		//chunks in the store
+	uint64_t bytes;			//bytes of the chunks in the store
+	uint64_t lookups;		//chunks looked up
+	uint64_t hits;			//chunks found already stored
+};
+
+// chunks by their SHA-256, each held once and shared by every extent with the same bytes
+class ChunkStore
+{
+	private:
+		SkipList<uint64_t, ExtentRun*> chunks;	//chunks by the first bytes of their digest
+		ChunkStats stats;						//counters of the store
+		mutex lock;								//files of different trees may share chunks
+	public:
+		ChunkStore();
+		ExtentRun* intern(const char *data, size_t length);	//returns the chunk holding the bytes, adding it if new
+		void release(ExtentRun *run);			//drops one reference to a chunk, freeing it after the last
+		ChunkStats getStats();					//returns the counters of the store
+};
+
+// returns the store every file keeps its chunks in
+ChunkStore& chunkStore();
+
+// returns the length of the first chunk of data, cut where the rolling hash matches
+size_t chunkLength(const char *data, size_t length);
+
+// returns the bytes of pages held by the distinct runs of a list, which it sorts
+uint64_t distinctBytes(Vector<const ExtentRun*> &runs);
+
+// content of a file; its length is the size of the node holding it
+class FileData
+{
+	private:
+		union {
+			char bytes[INLINE_BYTES];	//content of a small file
+			ExtentList *extents;		//extents of a larger file
+		};
+		uint8_t stored;			//bytes of a small file written so far
+		bool paged;				//the content is held in extents
+
+		int findExtent(uint64_t offset) const;	//returns the first extent ending past offset
+		void ownList();							//copies the list of extents if another file shares it
+		void ownRun(Extent &extent);			//copies the run of an extent if it is shared or stored
+		void addExtent(int index, uint64_t offset, uint64_t end);	//fills the hole before extent index with pages
+		int addChunks(int index, uint64_t offset, const char *data, uint64_t length);	//fills a hole with chunks
+		void writeExtents(uint64_t offset, const char *data, size_t length, bool dedup);	//writes bytes into extents
+		void toPages(bool dedup);				//moves the bytes of a small file into extents
+		void toInline(uint64_t size);			//moves the first size bytes back into the node
+		void clear();							//drops the extents
+	public:
+		FileData();
+		FileData(const FileData &other);		//shares the extents of other
+		FileData& operator=(const FileData &other);
+		~FileData();
+		void write(uint64_t offset, const char *data, size_t length, bool dedup);	//writes bytes, filling holes
+		void cut(uint64_t size);				//drops every byte at or past size
+		int read(uint64_t &offset, uint64_t end, iovec *spans, int max) const;	//points spans at the next bytes
+		uint64_t allocated() const;				//returns the bytes of pages the file reads
+		void addRuns(Vector<const ExtentRun*> &runs) const;	//appends every run the file reads
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include<iostream>
+#include<string>
+#include<cstring>
+#include<cerrno>
+#include<chrono>
+#include<thread>
+#include<algorithm>
+#include<stdlib.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include "vector.hpp"
+#include "protocol.hpp"
+using namespace std;
+
+// ---------------- vfsload: load generator for vfsd -------------------------
+// opens several connections, each on its own thread, and sends the same command in pipelined
+// batches; prints throughput and the latency distribution of the replies
+//
+// usage: vfsload [-s socket] [-c connections] [-n requests per connection] [-p pipeline depth] [command]
+
+// settings of a run
+struct Settings {
+	string path;			//socket of the server
+	int connections;		//number of concurrent connections
+	int requests;			//requests sent by each connection
+	int pipeline;			//requests in flight per connection
+	string command;			//command line sent in every request
+};
+
+// result of one connection
+struct Worker {
+	Vector<long long> latencies;	//nanoseconds from sending each request to reading its reply
+	string error;					//reason the connection stopped early, empty on success
+};
+
+// opens a connection to the server, returns -1 on failure
+int connectTo(const string &path)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// sends the requests of one connection and records the latency of each reply
+void runWorker(const Settings &settings, Worker *worker)
+{
+	int fd = connectTo(settings.path);
+	if(fd < 0)
+	{
+		worker->error = strerror(errno);
+		return;
+	}
+
+	// one pipelined batch of requests, built once
+	string batch;
+	for(int i = 0; i < settings.pipeline; i++)	appendFrame(batch, settings.command);
+
+	// variables for the received bytes and one reply
+	string in;
+	string reply;
+	char chunk[64 * 1024];
+
+	for(int done = 0; done < settings.requests; )
+	{
+		// the last batch may be shorter
+		int depth = min(settings.pipeline, settings.requests - done);
+		size_t length = (batch.size() / settings.pipeline) * depth;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		// sends the whole batch at once
+		for(size_t sent = 0; sent < length; )
+		{
+			ssize_t n = send(fd, batch.data() + sent, length - sent, MSG_NOSIGNAL);
+			if(n <= 0)
+			{
+				worker->error = strerror(errno);
+				close(fd);
+				return;
+			}
+			sent += n;
+		}
+
+		// reads the replies in order
+		size_t pos = 0;
+		for(int received = 0; received < depth; )
+		{
+			if(readFrame(in, pos, reply))
+			{
+				worker->latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+				received++;
+				continue;
+			}
+
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if(n <= 0)
+			{
+				worker->error = (n == 0) ? "server closed the connection" : strerror(errno);
+				close(fd);
+				return;
+			}
+			in.append(chunk, n);
+		}
+		in.erase(0, pos);
+
+		done += depth;
+	}
+
+	close(fd);
+}
+
+// returns the latency at the given percentile of sorted latencies, in microseconds
+double percentile(Vector<long long> &sorted, double p)
+{
+	int index = min(sorted.size() - 1, int(p / 100.0 * sorted.size()));
+	return sorted[index] / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+	Settings settings = {"vfs.sock", 4, 10000, 16, ""};
+
+	// parses the options, the remaining words form the command
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		     if(arg == "-s" && i + 1 < argc)	settings.path = argv[++i];
+		else if(arg == "-c" && i + 1 < argc)	settings.connections = atoi(argv[++i]);
+		else if(arg == "-n" && i + 1 < argc)	settings.requests = atoi(argv[++i]);
+		else if(arg == "-p" && i + 1 < argc)	settings.pipeline = atoi(argv[++i]);
+		else									settings.command += (settings.command.empty() ? "" : " ") + arg;
+	}
+
+	if(settings.command.empty())	settings.command = "pwd";
+
+	if(settings.connections <= 0 || settings.requests <= 0 || settings.pipeline <= 0)
+	{
+		cerr<<"usage: vfsload [-s socket] [-c connections] [-n requests] [-p pipeline] [command]"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	// runs every connection on its own thread
+	Worker *workers = new Worker[settings.connections];
+	thread *threads = new thread[settings.connections];
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(int i = 0; i < settings.connections; i++)	threads[i] = thread(runWorker, cref(settings), &workers[i]);
+	for(int i = 0; i < settings.connections; i++)	threads[i].join();
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	// gathers the latencies of every connection
+	Vector<long long> latencies;
+	for(int i = 0; i < settings.connections; i++)
+	{
+		if(!workers[i].error.empty())	cerr<<"connection "<<i<<": "<<workers[i].error<<endl;
+
+		for(int j = 0; j < workers[i].latencies.size(); j++)	latencies.push_back(workers[i].latencies[j]);
+	}
+
+	delete [] threads;
+	delete [] workers;
+
+	if(latencies.empty())
+	{
+		cerr<<"no request completed"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	sort(&latencies[0], &latencies[0] + latencies.size());
+
+	cout<<"command      : "<<settings.command<<endl
+		<<"connections  : "<<settings.connections<<" x "<<settings.requests<<" requests, pipeline "<<settings.pipeline<<endl
+		<<"completed    : "<<latencies.size()<<" in "<<elapsed<<" s"<<endl
+		<<"throughput   : "<<latencies.size() / elapsed<<" req/s"<<endl
+		<<"latency (us) : p50 "<<percentile(latencies, 50)
+		<<"  p90 "<<percentile(latencies, 90)
+		<<"  p99 "<<percentile(latencies, 99)
+		<<"  p99.9 "<<percentile(latencies, 99.9)
+		<<"  max "<<latencies.back() / 1000.0<<endl;
+
+	return(EXIT_SUCCESS);
+}
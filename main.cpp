@@ -1,55 +1,90 @@
 #include<iostream>
 #include<sstream>
+#include<cstring>
 #include<stdlib.h>
+#include<unistd.h>
+#include<readline/readline.h>
+#include<readline/history.h>
 #include "vfs.hpp"
+#include "shell.hpp"
 using namespace std;
 
+// tree the tab completion reads
+VFS *completion_vfs = nullptr;
+
+// returns the next path completing text, readline asks with state 0 for the first one
+char* nextCompletion(const char *text, int state)
+{
+	static Vector<string> names;
+	static int position;
+
+	if(state == 0)
+	{
+		names.clear();
+		position = 0;
+
+		// a path that cannot be resolved has no completions
+		try
+		{
+			completion_vfs->completeNames(text, names);
+		}
+		catch(exception &e) { }
+	}
+
+	if(position < names.size())	return strdup(names[position++].c_str());
+	return nullptr;
+}
+
+// completes the word under the cursor as a path in the tree
+char** completePath(const char *text, int start, int end)
+{
+	// the files of the host are never offered
+	rl_attempted_completion_over = 1;
+
+	// a folder is completed up to its slash, so the next name follows without a space
+	char **matches = rl_completion_matches(text, nextCompletion);
+	if(matches != nullptr && matches[1] == nullptr && strlen(matches[0]) > 0 && matches[0][strlen(matches[0]) - 1] == '/')
+	{
+		rl_completion_suppress_append = 1;
+	}
+	return matches;
+}
 
 int main()
 {
 	VFS vfs;
 
+	// a terminal gets line editing, history and tab completion; piped input is read as it comes
+	bool interactive = isatty(STDIN_FILENO);
+	if(interactive)
+	{
+		completion_vfs = &vfs;
+		rl_attempted_completion_function = completePath;
+	}
+
 	while(true)
 	{
 		string user_input;
-		string command;
-		string parameter1;
-		string parameter2;
-		cout<<">";
-		getline(cin,user_input);
-
-		// parse userinput into command and parameter(s)
-		stringstream sstr(user_input);
-		getline(sstr,command,' ');
-		getline(sstr,parameter1,' ');
-		getline(sstr,parameter2);
 
-		try
+		if(interactive)
 		{
-			//Required commands
-			     if(command=="help")		vfs.help();
-			else if(command=="pwd")			cout<<vfs.pwd()<<endl;
-			else if(command=="ls") 			vfs.ls(parameter1);
-			else if(command=="mkdir")		vfs.mkdir(parameter1);
-			else if(command=="touch")		vfs.touch(parameter1,stoi(parameter2));
-			else if(command=="cd")			vfs.cd(parameter1);
-			else if(command=="rm")			vfs.rm(parameter1);
-			else if(command=="size")		vfs.size(parameter1);
-			else if(command=="showbin")		vfs.showbin();
-			else if(command=="emptybin")	vfs.emptybin();
-			else if(command=="exit")		{vfs.exit(); return(EXIT_SUCCESS);}
-
-			//optional commands
-			else if(command=="find")		vfs.find(parameter1);
-			else if(command=="mv")			vfs.mv(parameter1, parameter2);
-			else if(command=="recover")		vfs.recover();
-			else if(command=="clear")		system("clear");
-			else 							cout<<command<<": command not found"<<endl;
+			// stops at the end of the input
+			char *line = readline(">");
+			if(line == nullptr)	return(EXIT_SUCCESS);
+
+			user_input = line;
+			if(!user_input.empty())	add_history(line);
+			free(line);
 		}
-		catch(exception &e)
+		else
 		{
-			cout<<"Exception: "<<e.what()<<endl;
+			cout<<">";
+
+			// stops at the end of the input
+			if(!getline(cin,user_input))	return(EXIT_SUCCESS);
 		}
 
+		// runs the command until one asks to exit
+		if(!runCommand(vfs,user_input))	return(EXIT_SUCCESS);
 	}
-}
\ No newline at end of file
+}
@@ -2,9 +2,12 @@
 #define NODE_H
 
 #include<cstdlib>
+#include<cstdint>
 #include<string>
 #include<ctime>
 #include "vector.hpp"
+#include "filedata.hpp"
+#include "skiplist.hpp"
 
 using namespace std;
 
@@ -12,22 +15,147 @@ using namespace std;
 enum NodeType {
     file = 0, 
     folder = 1,
+    symbolic_link = 2,
 };
 
+// aggregate counters of the subtree under a node, the node included
+struct Stats {
+    unsigned int files;     // number of files
+    unsigned int folders;   // number of folders
+    uint64_t max_file;      // size of the largest file
+    unsigned int max_count; // children of a folder holding max_file, at most as many as really do
+    unsigned int links;     // names of hard-linked files, at least as many as really are
+
+    Stats() : files(0), folders(0), max_file(0), max_count(0), links(0) { }
+
+    Stats(NodeType type, uint64_t size) :
+    files(type == file), folders(type == folder), max_file((type == file) ? size : 0), max_count(0), links(0)
+    { }
+};
+
+// limits on the subtree under a folder, 0 for no limit
+struct Quota {
+    uint64_t bytes;         // largest size of the folder, its own size included
+    uint64_t nodes;         // most files and folders under the folder
+};
+
+class Node;
+struct Watch;
+
+// name of a child as the key of the sorted children of a folder
+// -- points at the name held by the child, which is only renamed while out of its folder
+struct NameKey {
+    const string *name;     // name of the child
+
+    bool operator<(const NameKey &other) const { return *name < *other.name; }
+};
+
+// what a file, folder or symbolic link is, apart from the names it has in the tree
+// -- hard links are several nodes sharing one inode; a folder always has one name
+struct Inode {
+    NodeType type;          // type of the inode
+    uint64_t size;          // size of a file or link, total size of a folder counting each file once
+    Stats stats;            // counters of the subtree under a folder, of the file itself otherwise
+    uint64_t time_created;  // nanoseconds since the epoch when the inode was made
+    uint64_t time_modified; // last time the inode changed: a file's size, a folder's children
+    uint64_t time_accessed; // last time the inode was read, not kept apart by copy-on-write clones
+    FileData data;          // content of a file, or the path a symbolic link leads to
+    Vector<Node*>* names;   // nodes naming the inode once it has hard links, nullptr while it has one
+    Quota* quota;           // limits set on a folder, nullptr without any
+    Vector<Watch*>* watches; // watches on a folder, nullptr without any
+
+    Inode(NodeType type, uint64_t size, uint64_t time_created) :
+    type(type), size(size), stats(type, size),
+    time_created(time_created), time_modified(time_created), time_accessed(time_created), names(nullptr), quota(nullptr),
+    watches(nullptr)
+    { }
+
+    // a copy is a new inode with the same metadata, content and limits, and only its own name
+    // -- watches stay on the folder they were set on
+    Inode(const Inode &other) :
+    type(other.type), size(other.size), stats(other.stats), time_created(other.time_created),
+    time_modified(other.time_modified), time_accessed(other.time_accessed), data(other.data), names(nullptr),
+    quota((other.quota != nullptr) ? new Quota(*other.quota) : nullptr), watches(nullptr)
+    { }
+
+    ~Inode() {
+        delete names;
+        delete quota;
+        delete watches;
+    }
+};
+
+// name of an inode at one place in the tree
 class Node {
     private:
         string name;            // name of the node
-        NodeType type;          // type of node being created
-        unsigned int size;      // size of the current node
-        string time_created;    // timestamp of the node
+        Inode* inode;           // metadata and content the name leads to
         Vector<Node*> children; // children of the node
+        SkipList<NameKey, Node*>* by_name; // children by name once the folder is large, nullptr while it is small
         Node* parent;           // parent of the node
+        Node* cow_source;       // node whose children this copy still shares (copy-on-write)
+        Vector<Node*>* cow_clones; // copies still sharing the children of this node
+        uint64_t cow_epoch;     // copy-on-write epoch when a snapshot folder took the children slot by slot,
+                                // or when a node of the tree last left the snapshot folders reading it
+        int slot;               // index of the node in the children of its parent
+        int dirty;              // index of the folder in the dirty list of an open transaction, -1 if none
+        Node* tag_folder;       // nearest folder with a quota or a watch at or above the node, while tag_epoch is current
+        uint64_t tag_epoch;     // tag epoch of the tree when tag_folder was found, 0 if never
 
     public:
-		Node(string name, Node* parent, NodeType type, unsigned int size, string time_created) : 
-        name(name), type(type), size(size), time_created(time_created), parent(parent)
+		Node(string name, Node* parent, NodeType type, uint64_t size, uint64_t time_created) : 
+        name(name), inode(new Inode(type, size, time_created)), by_name(nullptr), parent(parent),
+        cow_source(nullptr), cow_clones(nullptr), cow_epoch(0), slot(0), dirty(-1), tag_folder(nullptr), tag_epoch(0)
 		{ }
 
+        // a new name for an existing inode, a hard link
+        // -- the caller adds it to the names of the inode
+        Node(string name, Node* parent, Inode* inode) :
+        name(name), inode(inode), by_name(nullptr), parent(parent), cow_source(nullptr), cow_clones(nullptr), cow_epoch(0), slot(0),
+        dirty(-1), tag_folder(nullptr), tag_epoch(0)
+        { }
+
+        // the inode goes with its last name
+        ~Node() {
+            delete by_name;
+
+            if (inode->names == nullptr) {
+                delete inode;
+                return;
+            }
+
+            Vector<Node*>* names = inode->names;
+            for (int i = 0; i < names->size(); i++) {
+                if ((*names)[i] == this) {
+                    names->erase(i);
+                    break;
+                }
+            }
+
+            // a single name needs no list
+            if (names->size() == 1) {
+                delete names;
+                inode->names = nullptr;
+            }
+        }
+
+        // read-only view of the node for callers of the query methods
+        const string& getName() const { return name; }
+        NodeType getType() const { return inode->type; }
+        uint64_t getSize() const { return inode->size; }
+        const Stats& getStats() const { return inode->stats; }
+        uint64_t getTimeCreated() const { return inode->time_created; }
+        uint64_t getTimeModified() const { return inode->time_modified; }
+        uint64_t getTimeAccessed() const { return inode->time_accessed; }
+        const FileData& getData() const { return inode->data; }
+        int getLinks() const { return (inode->names == nullptr) ? 1 : inode->names->size(); }
+        const Quota* getQuota() const { return inode->quota; }
+
+        // node holding the children read through this one, the source of a clone not expanded yet
+        // -- a snapshot folder that took the children slot by slot keeps its source but reads its own slots
+        Node* readSource() { return (cow_source != nullptr && children.empty()) ? cow_source : this; }
+        const Node* readSource() const { return (cow_source != nullptr && children.empty()) ? cow_source : this; }
+
 		friend class VFS;
 
 };
@@ -0,0 +1,54 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include<string>
+#include<cstdint>
+#include<stdexcept>
+
+using namespace std;
+
+// ---------------- Length-prefixed framing used by vfsd and vfsload -------------------------
+// every request and reply is a 4-byte big-endian length followed by that many bytes of text
+// -- a request holds one command line, a reply holds everything the command printed
+
+// largest frame accepted, so a corrupt length cannot exhaust memory
+const uint32_t MAX_FRAME = 16 * 1024 * 1024;
+
+// appends a frame holding payload to out
+inline void appendFrame(string &out, const string &payload) {
+    uint32_t length = payload.size();
+
+    out += char(length >> 24);
+    out += char(length >> 16);
+    out += char(length >> 8);
+    out += char(length);
+    out += payload;
+}
+
+// reads the frame starting at pos in buffer into payload and moves pos past it
+// -- returns false if the frame is not complete yet; throws if the length is too large
+inline bool readFrame(const string &buffer, size_t &pos, string &payload) {
+    // checks if the length is complete
+    if (buffer.size() - pos < 4) {
+        return false;
+    }
+
+    // decodes the length
+    uint32_t length = (uint32_t(uint8_t(buffer[pos])) << 24) | (uint32_t(uint8_t(buffer[pos + 1])) << 16) |
+                      (uint32_t(uint8_t(buffer[pos + 2])) << 8) | uint32_t(uint8_t(buffer[pos + 3]));
+
+    if (length > MAX_FRAME) {
+        throw runtime_error("Frame is too large");
+    }
+
+    // checks if the payload is complete
+    if (buffer.size() - pos - 4 < length) {
+        return false;
+    }
+
+    payload.assign(buffer, pos + 4, length);
+    pos += 4 + length;
+    return true;
+}
+
+#endif
@@ -15,11 +15,14 @@ class Queue
 		int size;		//current number of elements in the Queue
 		int front;		//front of the Queue
 		int rear;		//index where a new element will be added
+		void grow();	//doubles the capacity, keeping the order
 	public:
 		Queue(int capacity=10);
 		~Queue();
 		void enqueue(T); 
 		T dequeue();
+		void enqueue_front(T);	//puts an element back at the front
+		T dequeue_rear();		//takes back the element enqueued last
 		bool isEmpty();
 		bool isFull();
 		T& front_element();
@@ -49,9 +52,9 @@ template<typename T> T& Queue<T>::front_element() {
 // inserts element at the rear of the queue
 template<typename T> void Queue<T>::enqueue(T element)
 {
-	// checks if the queue is full and throws an exception
+	// makes room if the queue is full
 	if (isFull()) {
-		throw runtime_error("The queue is full");
+		grow();
 	}
 
 	// inserts element at the end of the queue
@@ -90,6 +93,65 @@ template<typename T> T Queue<T>::dequeue()
 	return front_element;
 
 }
+//===========================================
+// inserts element at the front of the queue
+template<typename T> void Queue<T>::enqueue_front(T element)
+{
+	// makes room if the queue is full
+	if (isFull()) {
+		grow();
+	}
+
+	// moves the front back by one position
+	// -- adding the capacity keeps the index positive
+	front = (front - 1 + capacity) % capacity;
+
+	// inserts element at the new front
+	array[front] = element;
+
+	// increasing size of the queue
+	size++;
+}
+
+//===========================================
+// removes the element at the rear of the queue
+template<typename T> T Queue<T>::dequeue_rear()
+{
+	// checks if the queue is empty and throws an exception
+	if (isEmpty()) {
+		throw runtime_error("The queue is empty");
+	}
+
+	// moves the rear back to the last element
+	rear = (rear - 1 + capacity) % capacity;
+
+	// reducing size of the queue
+	size--;
+
+	// returning the last element of the queue
+	return array[rear];
+}
+
+//===========================================
+// doubles the capacity of the queue
+template<typename T> void Queue<T>::grow()
+{
+	// new array to hold the elements
+	int new_capacity = (capacity > 0) ? 2 * capacity : 1;
+	T* new_array = new T[new_capacity];
+
+	// copies the elements from the front, unwrapping the circle
+	for (int i = 0; i < size; i++) {
+		new_array[i] = array[(front + i) % capacity];
+	}
+
+	delete[] array;
+	array = new_array;
+	capacity = new_capacity;
+	front = 0;
+	rear = size % capacity;
+}
+
 //===========================================
 // checks if the queue is empty
 template<typename T> bool Queue<T>::isEmpty()
@@ -0,0 +1,292 @@
+#include<iostream>
+#include<sstream>
+#include<csignal>
+#include<cstring>
+#include<cerrno>
+#include<stdlib.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<sys/epoll.h>
+#include "vfs.hpp"
+#include "shell.hpp"
+#include "protocol.hpp"
+using namespace std;
+
+// ---------------- vfsd: serves one vfs to many local clients over a Unix domain socket -------------------------
+// every connection has its own working folders; requests are length-prefixed command lines
+// (see protocol.hpp) and may be pipelined, the replies come back in the same order
+
+// number of events handled per epoll_wait
+const int MAX_EVENTS = 64;
+
+// size of a single read from a client
+const int READ_CHUNK = 64 * 1024;
+
+// state of one client connection
+struct Connection {
+	int fd;					//socket of the client
+	Session session;		//working folders of the client
+	string in;				//bytes received and not parsed yet
+	string out;				//replies not sent yet
+	bool closing;			//closes once out is sent
+	uint32_t events;		//events the connection is registered for
+};
+
+// cleared by SIGINT and SIGTERM to stop the event loop
+volatile sig_atomic_t running = 1;
+
+// stops the event loop
+void stop(int)
+{
+	running = 0;
+}
+
+// runs every complete request of a connection and queues the replies
+void handleRequests(VFS &vfs, Connection *conn, ostringstream &reply)
+{
+	// variables for the parse position, one request and whether the client asked to exit
+	size_t pos = 0;
+	string request;
+	bool exited = false;
+
+	// switches to the working folders of the client
+	vfs.setSession(conn->session);
+
+	// sends what the commands print into the reply buffer
+	streambuf *console = cout.rdbuf(reply.rdbuf());
+
+	try
+	{
+		while(!exited && readFrame(conn->in, pos, request))
+		{
+			reply.str("");
+
+			// a command asking to exit saves the vfs and ends the connection
+			if(!runCommand(vfs, request))	exited = conn->closing = true;
+
+			appendFrame(conn->out, reply.str());
+		}
+	}
+	catch(exception &e)
+	{
+		// a malformed frame ends the connection
+		conn->closing = true;
+	}
+
+	cout.rdbuf(console);
+
+	// keeps the working folders and the unparsed bytes
+	conn->session = vfs.getSession();
+	conn->in.erase(0, pos);
+}
+
+// sends queued replies until the socket would block
+// -- returns false if the connection failed
+bool flush(Connection *conn)
+{
+	// variable for the number of bytes sent
+	size_t sent = 0;
+
+	while(sent < conn->out.size())
+	{
+		ssize_t n = send(conn->fd, conn->out.data() + sent, conn->out.size() - sent, MSG_NOSIGNAL);
+
+		if(n < 0)
+		{
+			if(errno == EAGAIN || errno == EWOULDBLOCK)	break;
+			if(errno == EINTR)							continue;
+			return false;
+		}
+
+		sent += n;
+	}
+
+	conn->out.erase(0, sent);
+	return true;
+}
+
+// drops the watches of a client that leaves, and rolls back the transaction it leaves open so it
+// does not hold every other client off
+void endSession(VFS &vfs, Connection *conn)
+{
+	// nobody takes the events of its watches any more
+	vfs.unwatchSession(conn->session.id);
+
+	if(!vfs.inTransaction() || vfs.transactionOwner() != conn->session.id)	return;
+
+	try
+	{
+		vfs.setSession(conn->session);
+		vfs.abort();
+	}
+	catch(exception &e)
+	{
+		cerr<<"Exception: "<<e.what()<<endl;
+	}
+}
+
+// closes a connection and releases it
+void closeConnection(int epfd, Connection *conn)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+	close(conn->fd);
+	delete conn;
+}
+
+int main(int argc, char **argv)
+{
+	// socket path from the first argument
+	string path = (argc > 1) ? argv[1] : "vfs.sock";
+
+	VFS vfs;
+
+	// creates the listening socket
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if(path.size() >= sizeof(addr.sun_path))
+	{
+		cerr<<"Socket path is too long"<<endl;
+		return(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, path.c_str());
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(path.c_str());
+
+	if(listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0)
+	{
+		cerr<<"Failed to listen on "<<path<<": "<<strerror(errno)<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	// registers the listening socket, marked by a null pointer
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &event);
+
+	// stops cleanly on interrupt, ignores clients hanging up mid-write
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	signal(SIGPIPE, SIG_IGN);
+
+	cout<<"vfsd listening on "<<path<<endl;
+
+	// buffers shared by every request
+	epoll_event events[MAX_EVENTS];
+	char chunk[READ_CHUNK];
+	ostringstream reply;
+
+	// id of the next client; 0 is left to a tree with a single user
+	int next_client = 1;
+
+	while(running)
+	{
+		int count = epoll_wait(epfd, events, MAX_EVENTS, -1);
+
+		if(count < 0)
+		{
+			if(errno == EINTR)	continue;
+			break;
+		}
+
+		for(int i = 0; i < count; i++)
+		{
+			Connection *conn = (Connection*)events[i].data.ptr;
+
+			// accepts every pending client
+			if(conn == nullptr)
+			{
+				int fd;
+				while((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+				{
+					Connection *client = new Connection;
+					client->fd = fd;
+					client->session.curr = "";
+					client->session.prev = "";
+					client->session.id = next_client++;
+					client->closing = false;
+					client->events = EPOLLIN;
+
+					event.events = client->events;
+					event.data.ptr = client;
+					epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+				}
+				continue;
+			}
+
+			// reads everything the client sent
+			if(!conn->closing && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+			{
+				// variable for whether the client stopped sending
+				bool hung_up = false;
+
+				while(true)
+				{
+					ssize_t n = recv(conn->fd, chunk, READ_CHUNK, 0);
+
+					if(n > 0)
+					{
+						conn->in.append(chunk, n);
+						continue;
+					}
+					if(n < 0 && errno == EINTR)	continue;
+
+					// the client hung up or failed
+					if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))	hung_up = true;
+					break;
+				}
+
+				// runs the pipelined requests in order, including those sent before hanging up
+				handleRequests(vfs, conn, reply);
+
+				if(hung_up)	conn->closing = true;
+			}
+
+			// sends the replies, waiting for the socket when it is full
+			if(!flush(conn) || (conn->closing && conn->out.empty()))
+			{
+				endSession(vfs, conn);
+				closeConnection(epfd, conn);
+				continue;
+			}
+
+			// a closing connection only waits to send what is left
+			uint32_t wanted = conn->closing ? EPOLLOUT : (conn->out.empty() ? EPOLLIN : (EPOLLIN | EPOLLOUT));
+
+			if(conn->events != wanted)
+			{
+				conn->events = wanted;
+				event.events = wanted;
+				event.data.ptr = conn;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &event);
+			}
+		}
+	}
+
+	// saves the vfs on shutdown, without the changes of a transaction left open
+	try
+	{
+		if(vfs.inTransaction())
+		{
+			Session owner = {"", "", vfs.transactionOwner()};
+			vfs.setSession(owner);
+			vfs.abort();
+		}
+		vfs.exit();
+	}
+	catch(exception &e)
+	{
+		cerr<<"Exception: "<<e.what()<<endl;
+	}
+
+	close(listen_fd);
+	close(epfd);
+	unlink(path.c_str());
+
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,483 @@
+#include<iostream>
+#include<iomanip>
+#include<sstream>
+#include<stdlib.h>
+#include<unistd.h>
+#include<errno.h>
+#include "shell.hpp"
+using namespace std;
+
+// buffer of cout before any command runs, so cat can tell the console from a redirected cout
+static streambuf *console_buffer = cout.rdbuf();
+
+// ---------------- Console renderers -------------------------
+// the vfs returns nodes, sizes and paths; these turn them into the text printed by the commands
+
+// prints the available menu of commands
+void printHelp()
+{
+	cout<<"List of available Commands:"<<endl
+		<<"help                     : Prints the available menu of commands"<<endl
+		<<"pwd                      : Prints the path of the current node"<<endl
+		<<"ls [sort] [-o offset] [-n limit] [prefix*]"<<endl
+		<<"                         : Prints the children of the current node, optionally sorted, paged or filtered"<<endl
+		<<"mkdir <foldername>       : Creates a folder under the current folder"<<endl
+		<<"touch <filename> <size>  : Creates a file under the current node with specified filename and size"<<endl
+		<<"cd [ foldername | .. | - | /my/path/name]   "<<endl
+		<<"    [foldername]         : Changes current node to the specified folder"<<endl
+		<<"    [..]                 : Changes current node to its parent folder"<<endl
+		<<"    [-]                  : Changes current node to the previous working folder"<<endl
+		<<"    [/my/path/name]      : Changes current node to the specified path if it exists"<<endl
+		<<"rm <foldername>|<filename>   : Removes the specified folder or file"<<endl
+		<<"find <foldername>|<filename> : Returns the path of the file or the folder if it exists"<<endl
+		<<"mv <src> <dst>               : Moves a file or folder into the folder <dst>, or renames it if <dst> does not exist"<<endl
+		<<"cp [-r|-c] <src> <dst>       : Copies a file, or a folder with -r (-c shares it copy-on-write)"<<endl
+		<<"ln [-s] <target> <link>      : Gives a file a second name, or with -s makes a symbolic link holding the path target"<<endl
+		<<"size <foldername>|<filename> : Returns the total size of the folder or file, and the bytes of pages it holds"<<endl
+		<<"du [-d N] [path]             : Prints the bytes, files, folders and largest file under a node;"<<endl
+		<<"                               a file with hard links counts once per folder holding it"<<endl
+		<<"top <k> [path]               : Prints the k largest files under a folder"<<endl
+		<<"query [size<op>N] [ctime<op>T] [name=glob] [type=f|d] [-n limit] [path]"<<endl
+		<<"                         : Prints the nodes under a folder matching every predicate, <op> one of < <= = >= >;"<<endl
+		<<"                           N may end in K, M, G or T, T is epoch seconds or an age like -30m, -1h, -2d"<<endl
+		<<"                           a size or time range costs O(log n + min(range, nodes under the folder) * depth)"<<endl
+		<<"quota [-b bytes] [-n nodes] [path]"<<endl
+		<<"                         : Limits the bytes and the files and folders under a folder (0 drops a limit),"<<endl
+		<<"                           and prints the quotas applying to it"<<endl
+		<<"watch [-r] [path]        : Watches the changes in a folder, or anywhere below it with -r, and prints the id"<<endl
+		<<"events <id>              : Prints the changes a watch saw since the last time"<<endl
+		<<"unwatch <id>             : Drops a watch"<<endl
+		<<"begin                    : Opens a transaction"<<endl
+		<<"commit                   : Keeps the changes of the open transaction"<<endl
+		<<"abort                    : Rolls back the changes of the open transaction"<<endl
+		<<"snapshot create|restore|delete <name>"<<endl
+		<<"                         : Records the tree under a name, puts it back, or drops it"<<endl
+		<<"snapshot list            : Prints the snapshots"<<endl
+		<<"snapshot diff <from> [to]: Prints what changed between two snapshots, or from a snapshot to the tree"<<endl
+		<<"write [-o offset] <filename> <text>"<<endl
+		<<"                         : Makes a line of text the content of a file, or writes the text at offset"<<endl
+		<<"append <filename> <text> : Adds a line of text at the end of a file"<<endl
+		<<"truncate <filename> <size>   : Cuts a file down to size bytes, or grows it with a hole"<<endl
+		<<"cat [-o offset] [-n length] <filename>"<<endl
+		<<"                         : Prints the content of a file, or length bytes from offset"<<endl
+		<<"dedup [on|off]           : Shares identical chunks of written bytes, or stores every write apart"<<endl
+		<<"stat [path]              : Shows the size and names of a node, where a link points, and when it was created,"<<endl
+		<<"                           last modified and last accessed"<<endl
+		<<"save [-z] [file]         : Saves the tree to file, vfs.dat by default, compressed with -z"<<endl
+		<<"diff <file>              : Prints what differs from the tree to the tree saved in file"<<endl
+		<<"sync <file>              : Changes the tree to match the tree saved in file"<<endl
+		<<"showbin                  : Shows the oldest node of the bin"<<endl
+		<<"emptybin                 : Empties the bin"<<endl
+		<<"exit                     : The program exits"<<endl;
+}
+
+// returns the word the listings print for a type of node
+const char* typeName(NodeType type)
+{
+	if(type == folder)			return "dir";
+	if(type == symbolic_link)	return "link";
+	return "file";
+}
+
+// returns the word the listings print for the type of a node
+const char* typeName(const Node *node)
+{
+	return typeName(node->getType());
+}
+
+// appends text right-aligned in a column of the given width
+void appendPadded(string &out, const string &text, int width)
+{
+	if(int(text.size()) < width)	out.append(width - text.size(), ' ');
+	out += text;
+}
+
+// prints a listing one batch at a time, one line per node
+void printListing(VFS &vfs, Listing &listing)
+{
+	// variables for one batch of nodes and its rendered text
+	Node* batch[LIST_BATCH];
+	string out;
+
+	int count;
+	while((count = vfs.nextEntries(listing, batch, LIST_BATCH)) > 0)
+	{
+		out.clear();
+		for(int i = 0; i < count; i++)
+		{
+			// type, name and size aligned in columns
+			appendPadded(out, typeName(batch[i]), 4);
+			out += ' ';
+			appendPadded(out, batch[i]->getName(), 15);
+			out += ' ';
+			appendPadded(out, to_string(batch[i]->getSize()), 10);
+			out += ' ';
+
+			out += formatTimestamp(batch[i]->getTimeCreated()) + '\n';
+		}
+		cout<<out;
+	}
+}
+
+// prints the size and counters of every folder reported by du
+void printDu(const Vector<PathEntry> &entries)
+{
+	string out = "     bytes   files folders   largest path\n";
+	for(int i = 0; i < entries.size(); i++)
+	{
+		// the counters of the node exclude the node itself
+		const Node *node = entries[i].node;
+		const Stats &stats = node->getStats();
+
+		appendPadded(out, to_string(node->getSize()), 10);
+		out += ' ';
+		appendPadded(out, to_string(stats.files), 7);
+		out += ' ';
+		appendPadded(out, to_string(stats.folders - (node->getType() == folder)), 7);
+		out += ' ';
+		appendPadded(out, to_string(stats.max_file), 9);
+		out += ' ' + entries[i].path + '\n';
+	}
+	cout<<out;
+}
+
+// prints the size and path of every file reported by top
+void printTop(const Vector<PathEntry> &entries)
+{
+	string out;
+	for(int i = 0; i < entries.size(); i++)
+	{
+		appendPadded(out, to_string(entries[i].node->getSize()), 10);
+		out += ' ' + entries[i].path + '\n';
+	}
+	cout<<out;
+}
+
+// prints the size, creation time and path of every node found by query
+void printQuery(const Vector<PathEntry> &entries)
+{
+	string out;
+	for(int i = 0; i < entries.size(); i++)
+	{
+		appendPadded(out, to_string(entries[i].node->getSize()), 10);
+		out += ' ' + formatTimestamp(entries[i].node->getTimeCreated()) + ' ' + entries[i].path + '\n';
+	}
+	cout<<out;
+}
+
+// appends what a folder holds against its limit, or against none
+void appendUsage(string &out, uint64_t used, uint64_t limit)
+{
+	appendPadded(out, to_string(used) + " / " + ((limit > 0) ? to_string(limit) : "-"), 24);
+}
+
+// prints the bytes, files and folders every quota folder holds against its limits
+void printQuota(const Vector<PathEntry> &entries)
+{
+	string out = "                   bytes                    nodes path\n";
+	for(int i = 0; i < entries.size(); i++)
+	{
+		// the nodes exclude the folder itself
+		const Node *node = entries[i].node;
+		const Quota *limits = node->getQuota();
+
+		appendUsage(out, node->getSize(), limits->bytes);
+		out += ' ';
+		appendUsage(out, node->getStats().files + node->getStats().folders - 1, limits->nodes);
+		out += ' ' + entries[i].path + '\n';
+	}
+	cout<<out;
+}
+
+// prints the events a watch holds, one batch at a time
+// -- merged events show how many they stand for and the two events of a move share a cookie
+void printEvents(WatchRing *ring)
+{
+	// variables for one batch of events and its rendered text
+	WatchEvent batch[WATCH_BATCH];
+	string out;
+
+	int count;
+	while((count = ring->pop(batch, WATCH_BATCH)) > 0)
+	{
+		out.clear();
+		for(int i = 0; i < count; i++)
+		{
+			const WatchEvent &event = batch[i];
+			if(event.type == watch_overflow)
+			{
+				out += "overflow   " + to_string(event.count) + " events dropped\n";
+				continue;
+			}
+
+			appendPadded(out, watchTypeName(event.type), 10);
+			out += ' ';
+			appendPadded(out, typeName(event.node_type), 4);
+			out += ' ' + event.path;
+
+			if(event.count > 1)		out += " x" + to_string(event.count);
+			if(event.cookie != 0)	out += " (cookie " + to_string(event.cookie) + ")";
+			out += '\n';
+		}
+		cout<<out;
+	}
+}
+
+// prints one path per line
+void printPaths(const Vector<PathEntry> &entries)
+{
+	for(int i = 0; i < entries.size(); i++)	cout<<entries[i].path<<endl;
+}
+
+// prints the name, total size and time of every snapshot
+void printSnapshots(const Vector<Snapshot> &snapshots)
+{
+	string out;
+	for(int i = 0; i < snapshots.size(); i++)
+	{
+		appendPadded(out, snapshots[i].name, 15);
+		out += ' ';
+		appendPadded(out, to_string(snapshots[i].root->getSize()), 10);
+		out += ' ' + formatTimestamp(snapshots[i].time_created) + '\n';
+	}
+	cout<<out;
+}
+
+// prints one change per line, marked +, - or ~
+void printDiff(const Vector<DiffEntry> &changes)
+{
+	string out;
+	for(int i = 0; i < changes.size(); i++)
+	{
+		out += changes[i].change;
+		out += ' ' + changes[i].path + '\n';
+	}
+	cout<<out;
+}
+
+// prints the differences from the tree to a tree file
+void printTreeChanges(const Vector<TreeChange> &changes)
+{
+	string out;
+	for(int i = 0; i < changes.size(); i++)	out += formatChange(changes[i]);
+	cout<<out;
+}
+
+// runs a snapshot subcommand
+void runSnapshot(VFS &vfs, const string &subcommand, const string &params)
+{
+	// the first name and an optional second one
+	stringstream pstr(params);
+	string name, other;
+	pstr>>name>>other;
+
+	     if(subcommand=="create")	vfs.snapshotCreate(name);
+	else if(subcommand=="list")		printSnapshots(vfs.snapshotList());
+	else if(subcommand=="diff")		printDiff(vfs.snapshotDiff(name, other));
+	else if(subcommand=="restore")	vfs.snapshotRestore(name);
+	else if(subcommand=="delete")	vfs.snapshotDelete(name);
+	else							throw runtime_error("Invalid parameter");
+}
+
+// writes spans to the console with as few system calls as the kernel allows
+void writeSpans(iovec *spans, int count)
+{
+	while(count > 0)
+	{
+		ssize_t written = writev(STDOUT_FILENO, spans, count);
+		if(written < 0)
+		{
+			if(errno == EINTR)	continue;
+			throw runtime_error("Failed to write to the console");
+		}
+
+		// skips the spans written in full and the written part of the next one
+		while(count > 0 && size_t(written) >= spans->iov_len)
+		{
+			written -= spans->iov_len;
+			spans++;
+			count--;
+		}
+		if(count > 0)
+		{
+			spans->iov_base = (char*)spans->iov_base + written;
+			spans->iov_len -= written;
+		}
+	}
+}
+
+// prints the content of a file one batch of spans at a time, without copying it
+// -- on the console the spans go to the terminal with writev; a redirected cout, like the reply
+//    of vfsd, takes them straight into its buffer
+void printContent(VFS &vfs, ReadCursor &cursor)
+{
+	// variables for one batch of spans and where they go
+	iovec batch[READ_BATCH];
+	streambuf *out = cout.rdbuf();
+	bool console = (out == console_buffer);
+
+	// text already printed goes out first
+	if(console)	cout.flush();
+
+	int count;
+	while((count = vfs.nextSpans(cursor, batch, READ_BATCH)) > 0)
+	{
+		if(console)	writeSpans(batch, count);
+		else for(int i = 0; i < count; i++)	out->sputn((char*)batch[i].iov_base, batch[i].iov_len);
+	}
+}
+
+// prints the size and times of a node, the bytes of pages a file holds and the names it has
+// -- a symbolic link is not followed, so its own times and the path it holds are shown
+void printStat(VFS &vfs, const string &path)
+{
+	const Node *node = vfs.resolve(path, false);
+	if(node == nullptr)	throw runtime_error("Invalid path");
+
+	cout<<"size     : "<<node->getSize()<<endl;
+	if(node->getType() == file)				cout<<"allocated: "<<node->getData().allocated()<<endl;
+	if(node->getType() == symbolic_link)	cout<<"link     : -> "<<vfs.readlink(path)<<endl;
+
+	cout<<"links    : "<<node->getLinks()<<endl;
+
+	cout<<"created  : "<<formatTimestamp(node->getTimeCreated())<<endl
+		<<"modified : "<<formatTimestamp(node->getTimeModified())<<endl
+		<<"accessed : "<<formatTimestamp(node->getTimeAccessed())<<endl;
+}
+
+// prints the oldest node of the bin
+void printBinEntry(const PathEntry &entry)
+{
+	cout<<setw(4)<<typeName(entry.node)<<" "
+		<<setw(10)<<entry.node->getName()
+		<<" "<<setw(5)<<entry.node->getSize()
+		<<" "<<setw(15)<<entry.path
+		<<" "<<setw(15)<<formatTimestamp(entry.node->getTimeCreated())<<endl;
+}
+
+
+// parses one command line and runs it against the vfs, printing to cout
+bool runCommand(VFS &vfs, const string &user_input)
+{
+	string command;
+	string parameter1;
+	string parameter2;
+
+	// parse userinput into command and parameter(s)
+	stringstream sstr(user_input);
+	getline(sstr,command,' ');
+	getline(sstr,parameter1,' ');
+	getline(sstr,parameter2);
+
+	try
+	{
+		//Required commands
+		     if(command=="help")		printHelp();
+		else if(command=="pwd")			cout<<vfs.pwd()<<endl;
+		else if(command=="ls")
+		{
+			Listing listing = vfs.ls(parameter1+" "+parameter2);
+			printListing(vfs, listing);
+		}
+		else if(command=="mkdir")		vfs.mkdir(parameter1);
+		else if(command=="touch")		vfs.touch(parameter1,stoull(parameter2));
+		else if(command=="cd")			vfs.cd(parameter1);
+		else if(command=="rm")			vfs.rm(parameter1);
+		else if(command=="size")		cout<<vfs.size(parameter1)<<" logical, "<<vfs.physicalSize(parameter1)<<" physical"<<endl;
+		else if(command=="du")			printDu(vfs.du(parameter1+" "+parameter2));
+		else if(command=="top")			printTop(vfs.top(parameter1+" "+parameter2));
+		else if(command=="query")		printQuery(vfs.query(parameter1+" "+parameter2));
+		else if(command=="quota")		printQuota(vfs.quota(parameter1+" "+parameter2));
+		else if(command=="watch")		cout<<"watch "<<vfs.watch(parameter1+" "+parameter2)<<endl;
+		else if(command=="events")		printEvents(vfs.watchRing(stoi(parameter1)));
+		else if(command=="unwatch")		vfs.unwatch(stoi(parameter1));
+		else if(command=="showbin")		printBinEntry(vfs.showbin());
+		else if(command=="emptybin")	vfs.emptybin();
+		else if(command=="exit")		{vfs.exit(); return false;}
+
+		//optional commands
+		else if(command=="find")		printPaths(vfs.find(parameter1));
+		else if(command=="mv")			vfs.mv(parameter1, parameter2);
+		else if(command=="cp")
+		{
+			// cp [-r|-c] <src> <dst>
+			if(parameter1=="-r" || parameter1=="-c")
+			{
+				stringstream pstr(parameter2);
+				string src, dst;
+				getline(pstr,src,' ');
+				getline(pstr,dst);
+				vfs.cp(src, dst, true, parameter1=="-c");
+			}
+			else							vfs.cp(parameter1, parameter2, false, false);
+		}
+		else if(command=="ln")
+		{
+			// ln [-s] <target> <link>
+			if(parameter1=="-s")
+			{
+				stringstream pstr(parameter2);
+				string target, link;
+				getline(pstr,target,' ');
+				getline(pstr,link);
+				vfs.ln(target, link, true);
+			}
+			else							vfs.ln(parameter1, parameter2, false);
+		}
+		else if(command=="recover")		vfs.recover();
+		else if(command=="begin")		vfs.begin();
+		else if(command=="commit")		vfs.commit();
+		else if(command=="abort")		vfs.abort();
+		else if(command=="snapshot")	runSnapshot(vfs, parameter1, parameter2);
+		else if(command=="stat")		printStat(vfs, parameter1);
+		else if(command=="write")
+		{
+			// write [-o offset] <file> <text>
+			if(parameter1=="-o")
+			{
+				stringstream pstr(parameter2);
+				string offset, path, text;
+				getline(pstr,offset,' ');
+				getline(pstr,path,' ');
+				getline(pstr,text);
+				vfs.write(path, stoull(offset), text);
+			}
+			else
+			{
+				// the line replaces the content, like echo into a file
+				vfs.overwrite(parameter1, parameter2+'\n');
+			}
+		}
+		else if(command=="dedup")
+		{
+			// dedup [on|off]
+			if(parameter1=="on" || parameter1=="off")	vfs.setDedup(parameter1=="on");
+			else if(!parameter1.empty())				throw runtime_error("Invalid parameter");
+			cout<<"dedup "<<(vfs.getDedup() ? "on" : "off")<<endl;
+		}
+		else if(command=="append")		vfs.append(parameter1, parameter2+'\n');
+		else if(command=="truncate")	vfs.truncate(parameter1, stoull(parameter2));
+		else if(command=="cat")
+		{
+			ReadCursor cursor = vfs.cat(parameter1+" "+parameter2);
+			printContent(vfs, cursor);
+		}
+		else if(command=="save")
+		{
+			// save [-z] [file]
+			bool compressed = (parameter1=="-z");
+			string filename = compressed ? parameter2 : parameter1;
+			vfs.save(filename.empty() ? "vfs.dat" : filename, compressed);
+		}
+		else if(command=="diff")		printTreeChanges(vfs.diff(parameter1));
+		else if(command=="sync")		cout<<vfs.sync(parameter1)<<" changes applied"<<endl;
+		else if(command=="clear")		system("clear");
+		else 							cout<<command<<": command not found"<<endl;
+	}
+	catch(exception &e)
+	{
+		cout<<"Exception: "<<e.what()<<endl;
+	}
+
+	return true;
+}
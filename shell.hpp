@@ -0,0 +1,13 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include<string>
+#include "vfs.hpp"
+
+using namespace std;
+
+// parses one command line and runs it against the vfs, printing to cout
+// -- returns false once the command asks to exit
+bool runCommand(VFS &vfs, const string &user_input);
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include<cstdlib>
+#include<stdexcept>
+
+using namespace std;
+
+// maximum number of levels of a skip list
+const int SKIPLIST_LEVELS = 24;
+
+// ordered multimap kept sorted by (key, value)
+// -- the value breaks ties so a specific entry can be erased
+template <typename K, typename V>
+class SkipList
+{
+	public:
+		struct Entry {
+			K key;					//key the entries are ordered by
+			V value;				//value stored with the key
+			int levels;				//number of levels the entry is linked on
+			Entry *prev;			//previous entry on the bottom level
+			Entry **next;			//next entry on each level
+		};
+
+	private:
+		Entry *head;				//sentinel before the first entry
+		int levels;					//number of levels in use
+		int count;					//current number of entries
+		unsigned int seed;			//state of the level generator
+		int randomLevel();
+		bool before(Entry *entry, K key, V value);
+	public:
+		SkipList();
+		~SkipList();
+		void insert(K key, V value);	//Adds an entry
+		bool erase(K key, V value);		//Removes an entry, returns false if it is missing
+		Entry* first();					//Returns the smallest entry, nullptr if empty
+		Entry* last();					//Returns the largest entry, nullptr if empty
+		Entry* lowerBound(K key);		//Returns the first entry with a key not less than key
+		int size() const;				//Returns the number of entries
+		bool empty() const;				//Returns true if the skip list is empty
+		void clear();					//Removes every entry
+};
+
+// ------------- SkipList class definition ----------------------- //
+
+// constructor of the skip list class
+template <typename K, typename V>
+SkipList<K, V>::SkipList() : levels(1), count(0), seed(2463534242u) {
+	// the sentinel is linked on every level
+	head = new Entry;
+	head->levels = SKIPLIST_LEVELS;
+	head->prev = nullptr;
+	head->next = new Entry*[SKIPLIST_LEVELS];
+
+	for (int i = 0; i < SKIPLIST_LEVELS; i++) {
+		head->next[i] = nullptr;
+	}
+}
+
+// destructor of the skip list class
+template <typename K, typename V>
+SkipList<K, V>::~SkipList() {
+	clear();
+
+	// deallocates the sentinel
+	delete [] head->next;
+	delete head;
+}
+
+// returns the number of levels of a new entry, each level with half the chance of the previous
+template <typename K, typename V>
+int SkipList<K, V>::randomLevel() {
+	// xorshift step
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+
+	// counts the trailing one bits
+	int level = 1;
+	for (unsigned int bits = seed; (bits & 1) && level < SKIPLIST_LEVELS; bits >>= 1) {
+		level++;
+	}
+
+	return level;
+}
+
+// returns true if entry comes before (key, value)
+template <typename K, typename V>
+bool SkipList<K, V>::before(Entry *entry, K key, V value) {
+	return (entry->key < key) || (!(key < entry->key) && entry->value < value);
+}
+
+// adds an entry
+template <typename K, typename V>
+void SkipList<K, V>::insert(K key, V value) {
+	// finds the last entry before the new one on each level
+	Entry* update[SKIPLIST_LEVELS];
+	Entry* curr = head;
+	for (int i = levels - 1; i >= 0; i--) {
+		while (curr->next[i] != nullptr && before(curr->next[i], key, value)) {
+			curr = curr->next[i];
+		}
+		update[i] = curr;
+	}
+
+	// creates the entry
+	Entry* entry = new Entry;
+	entry->key = key;
+	entry->value = value;
+	entry->levels = randomLevel();
+	entry->next = new Entry*[entry->levels];
+
+	// opens the new levels from the sentinel
+	for (; levels < entry->levels; levels++) {
+		update[levels] = head;
+	}
+
+	// links the entry after the entries found on each of its levels
+	for (int i = 0; i < entry->levels; i++) {
+		entry->next[i] = update[i]->next[i];
+		update[i]->next[i] = entry;
+	}
+
+	// links the bottom level backwards
+	entry->prev = (update[0] == head) ? nullptr : update[0];
+	if (entry->next[0] != nullptr) {
+		entry->next[0]->prev = entry;
+	}
+
+	count++;
+}
+
+// removes an entry, returns false if it is missing
+template <typename K, typename V>
+bool SkipList<K, V>::erase(K key, V value) {
+	// finds the last entry before the one to remove on each level
+	Entry* update[SKIPLIST_LEVELS];
+	Entry* curr = head;
+	for (int i = levels - 1; i >= 0; i--) {
+		while (curr->next[i] != nullptr && before(curr->next[i], key, value)) {
+			curr = curr->next[i];
+		}
+		update[i] = curr;
+	}
+
+	// checks if the entry exists
+	Entry* entry = curr->next[0];
+	if (entry == nullptr || entry->key < key || key < entry->key || !(entry->value == value)) {
+		return false;
+	}
+
+	// unlinks the entry from each of its levels
+	for (int i = 0; i < entry->levels; i++) {
+		update[i]->next[i] = entry->next[i];
+	}
+	if (entry->next[0] != nullptr) {
+		entry->next[0]->prev = entry->prev;
+	}
+
+	// drops levels left empty
+	while (levels > 1 && head->next[levels - 1] == nullptr) {
+		levels--;
+	}
+
+	// deallocates the entry
+	delete [] entry->next;
+	delete entry;
+	count--;
+
+	return true;
+}
+
+// returns the smallest entry, nullptr if empty
+template <typename K, typename V>
+typename SkipList<K, V>::Entry* SkipList<K, V>::first() {
+	return head->next[0];
+}
+
+// returns the largest entry, nullptr if empty
+template <typename K, typename V>
+typename SkipList<K, V>::Entry* SkipList<K, V>::last() {
+	// walks as far right as possible on each level
+	Entry* curr = head;
+	for (int i = levels - 1; i >= 0; i--) {
+		while (curr->next[i] != nullptr) {
+			curr = curr->next[i];
+		}
+	}
+
+	return (curr == head) ? nullptr : curr;
+}
+
+// returns the first entry with a key not less than key
+template <typename K, typename V>
+typename SkipList<K, V>::Entry* SkipList<K, V>::lowerBound(K key) {
+	Entry* curr = head;
+	for (int i = levels - 1; i >= 0; i--) {
+		while (curr->next[i] != nullptr && curr->next[i]->key < key) {
+			curr = curr->next[i];
+		}
+	}
+
+	return curr->next[0];
+}
+
+// returns the number of entries
+template <typename K, typename V>
+int SkipList<K, V>::size() const {
+	return count;
+}
+
+// returns true if the skip list is empty
+template <typename K, typename V>
+bool SkipList<K, V>::empty() const {
+	return count == 0;
+}
+
+// removes every entry
+template <typename K, typename V>
+void SkipList<K, V>::clear() {
+	// deallocates the entries along the bottom level
+	Entry* curr = head->next[0];
+	while (curr != nullptr) {
+		Entry* next = curr->next[0];
+		delete [] curr->next;
+		delete curr;
+		curr = next;
+	}
+
+	// resets the sentinel
+	for (int i = 0; i < SKIPLIST_LEVELS; i++) {
+		head->next[i] = nullptr;
+	}
+	levels = 1;
+	count = 0;
+}
+
+#endif
@@ -0,0 +1,670 @@
+#include<iostream>
+#include<string>
+#include<fstream>
+#include<stdexcept>
+#include<stdlib.h>
+#include<unistd.h>
+#include "vfs.hpp"
+#include "asyncvfs.hpp"
+using namespace std;
+
+// ---------------- vfstest: regression tests of the tree -------------------------
+// every test builds a fresh tree and checks one behaviour; the failed checks are printed and the
+// exit status tells if any failed
+//
+// usage: vfstest
+
+// checks that failed so far
+int failures = 0;
+
+// records a check, printing it if it failed
+void check(bool passed, const string &test, const string &what)
+{
+	if(passed)	return;
+
+	cout<<"FAIL "<<test<<": "<<what<<endl;
+	failures++;
+}
+
+// returns true if running the mutation threw
+template <typename Mutation>
+bool throws(Mutation mutation)
+{
+	try
+	{
+		mutation();
+	}
+	catch(exception &e)
+	{
+		return true;
+	}
+	return false;
+}
+
+// a node that cannot be recovered is moved behind the others, so the newer ones can still be
+// recovered, and it goes back once its folder is there again
+void testRecoverSkipsLostNode()
+{
+	string test = "recover skips lost node";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.touch("x.txt", 1);
+
+	// x.txt goes to the bin before the folder it was in
+	vfs.rm("x.txt");
+	vfs.cd("/");
+	vfs.rm("a");
+
+	check(throws([&]() { vfs.recover(); }), test, "recovering x.txt without its folder succeeded");
+	check(!throws([&]() { vfs.recover(); }), test, "the folder behind x.txt was not recovered");
+	check(vfs.resolve("/a") != nullptr, test, "/a is missing after recover");
+	check(!throws([&]() { vfs.recover(); }), test, "x.txt was not recovered once its folder was back");
+	check(vfs.resolve("/a/x.txt") != nullptr, test, "/a/x.txt is missing after recover");
+}
+
+// a skipped node goes back to the front of the bin when the transaction is aborted
+void testAbortRestoresSkip()
+{
+	string test = "abort restores skip";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.touch("x.txt", 1);
+	vfs.rm("x.txt");
+	vfs.cd("/");
+	vfs.rm("a");
+
+	vfs.begin();
+	throws([&]() { vfs.recover(); });
+	vfs.abort();
+
+	check(vfs.showbin().path == "/a/x.txt", test, "the oldest node of the bin is " + vfs.showbin().path);
+}
+
+// while one client has a transaction open the others cannot change the tree, so its abort never
+// rolls back changes they were told had succeeded
+void testTransactionRefusesOtherClients()
+{
+	string test = "transaction refuses other clients";
+	VFS vfs;
+	Session first = vfs.getSession();
+	Session second = first;
+	first.id = 1;
+	second.id = 2;
+
+	vfs.setSession(first);
+	vfs.begin();
+	vfs.mkdir("fromA");
+
+	vfs.setSession(second);
+	check(throws([&]() { vfs.mkdir("fromB"); }), test, "mkdir of another client succeeded");
+	check(throws([&]() { vfs.touch("bf", 5); }), test, "touch of another client succeeded");
+	check(throws([&]() { vfs.write("bw", 0, "text"); }), test, "write of another client succeeded");
+	check(throws([&]() { vfs.rm("fromA"); }), test, "rm of another client succeeded");
+	check(throws([&]() { vfs.save("other.dat", false); }), test, "save of another client succeeded");
+	check(throws([&]() { vfs.abort(); }), test, "abort of another client succeeded");
+
+	vfs.setSession(first);
+	vfs.abort();
+	check(vfs.resolve("/fromA") == nullptr, test, "/fromA is still there after abort");
+
+	// the tree is open to every client again
+	vfs.setSession(second);
+	check(!throws([&]() { vfs.mkdir("fromB"); }), test, "mkdir failed after the transaction ended");
+	check(vfs.resolve("/fromB") != nullptr, test, "/fromB is missing");
+}
+
+// the watches of a session are dropped when it ends, the watches of the others stay
+void testSessionEndDropsWatches()
+{
+	string test = "session end drops watches";
+	VFS vfs;
+	Session first = vfs.getSession();
+	Session second = first;
+	first.id = 1;
+	second.id = 2;
+
+	vfs.setSession(first);
+	int dropped = vfs.watch("/");
+	vfs.setSession(second);
+	int kept = vfs.watch("-r /");
+
+	vfs.unwatchSession(1);
+	check(throws([&]() { vfs.watchRing(dropped); }), test, "the watch of the ended session is still there");
+	check(!throws([&]() { vfs.watchRing(kept); }), test, "the watch of the other session was dropped");
+}
+
+// cd - can lead back into a removed folder; emptying the bin moves the working folders to the root
+// instead of leaving them in the deleted nodes
+void testEmptybinLeavesRemovedFolder()
+{
+	string test = "emptybin leaves removed folder";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.cd("/");
+	vfs.rm("a");
+
+	// the current folder is now the removed one
+	vfs.cd("-");
+	vfs.emptybin();
+
+	check(vfs.pwd() == "/", test, "the current folder is " + vfs.pwd());
+	vfs.mkdir("b");
+	vfs.cd("-");
+	check(vfs.pwd() == "/", test, "the previous folder is " + vfs.pwd());
+	check(!throws([&]() { vfs.query("size>=0 /"); }), test, "query failed after emptybin");
+}
+
+// a recover that fails puts a node behind the folder it was removed from, so emptying the bin
+// deletes that folder first; the copy-on-write clone left behind must not reach it when its source goes
+void testEmptybinOutlivesOldFolder()
+{
+	string test = "emptybin outlives old folder";
+	VFS vfs;
+	vfs.mkdir("s");
+	vfs.cd("s");
+	vfs.touch("f.txt", 10);
+	vfs.cd("/");
+	vfs.mkdir("q");
+	vfs.cp("s", "q/c", true, true);
+
+	// the bin holds c, then q, then s
+	vfs.cd("q");
+	vfs.rm("c");
+	vfs.cd("/");
+	vfs.rm("q");
+	vfs.rm("s");
+
+	// c cannot go back, so the bin is q, s, then c
+	check(throws([&]() { vfs.recover(); }), test, "c was recovered without its folder");
+	check(!throws([&]() { vfs.emptybin(); }), test, "emptybin failed");
+	check(vfs.size("/") == 0, test, "the root has " + to_string(vfs.size("/")) + " bytes");
+}
+
+// the largest file of a folder follows removals and moves without recounting every child, and
+// falls to the next largest once the last file holding it is gone
+void testLargestFileFollowsChanges()
+{
+	string test = "largest file follows changes";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.mkdir("b");
+	vfs.cd("a");
+	vfs.touch("small", 5);
+	vfs.touch("big1", 9);
+	vfs.touch("big2", 9);
+
+	vfs.rm("big1");
+	check(vfs.resolve("/a")->getStats().max_file == 9, test, "the largest file of /a left with one of two");
+	vfs.mv("big2", "/b");
+	check(vfs.resolve("/a")->getStats().max_file == 5, test, "/a kept the largest file it moved out");
+	check(vfs.resolve("/b")->getStats().max_file == 9, test, "/b did not gain the largest file");
+	check(vfs.resolve("/")->getStats().max_file == 9, test, "the root lost the largest file moving below it");
+
+	vfs.truncate("small", 2);
+	check(vfs.resolve("/a")->getStats().max_file == 2, test, "/a kept the size a truncated file had");
+	vfs.cd("/");
+	vfs.rm("b");
+	check(vfs.resolve("/")->getStats().max_file == 2, test, "the root kept the largest file of a removed folder");
+}
+
+// returns the names a listing reads, separated by spaces
+string listedNames(VFS &vfs, const string &params)
+{
+	Listing listing = vfs.ls(params);
+	Node *batch[LIST_BATCH];
+	string names;
+	int count;
+	while((count = vfs.nextEntries(listing, batch, 2)) > 0)
+	{
+		for(int i = 0; i < count; i++)	names += batch[i]->getName() + " ";
+	}
+	return names;
+}
+
+// a large folder keeps its children by name through creations, removals and renames, so lookups
+// and prefix listings see every change
+void testNameIndexFollowsChanges()
+{
+	string test = "name index follows changes";
+	VFS vfs;
+	for(int i = 0; i < NAME_INDEX_MIN * 2; i++)	vfs.touch("f" + to_string(i), 1);
+
+	check(listedNames(vfs, "f10*") == "f10 f100 f101 f102 f103 f104 f105 f106 f107 f108 f109 ", test, "f10* listed " + listedNames(vfs, "f10*"));
+	check(listedNames(vfs, "-o 2 -n 3 f10*") == "f101 f102 f103 ", test, "a page of f10* listed " + listedNames(vfs, "-o 2 -n 3 f10*"));
+
+	vfs.rm("f101");
+	vfs.mv("f102", "a102");
+	vfs.touch("f10a", 1);
+	check(listedNames(vfs, "f10*") == "f10 f100 f103 f104 f105 f106 f107 f108 f109 f10a ", test, "f10* listed " + listedNames(vfs, "f10*") + "after the changes");
+	check(vfs.resolve("f101") == nullptr, test, "f101 is found after rm");
+	check(vfs.resolve("a102") != nullptr && vfs.resolve("f102") == nullptr, test, "f102 is found under its old name");
+	check(throws([&]() { vfs.touch("f10a", 1); }), test, "a second f10a was created");
+}
+
+// a hard-linked file counts once in every folder holding a name of it
+void testDuCountsFileOnce()
+{
+	string test = "du counts a file once";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.write("x.txt", 0, string(8192, 'x'));
+	uint64_t physical = vfs.physicalSize("/a");
+
+	vfs.ln("x.txt", "y.txt", false);
+	vfs.mkdir("b");
+	vfs.ln("x.txt", "b/z.txt", false);
+
+	// the folder holds its own 10 bytes, b's 10 bytes and the file once, but still three names
+	Vector<PathEntry> entries = vfs.du("/a");
+	check(entries.size() == 1, test, "du of /a returned " + to_string(entries.size()) + " folders");
+	check(entries[0].node->getSize() == 10 + 10 + 8192, test, "du of /a has " + to_string(entries[0].node->getSize()) + " bytes");
+	check(entries[0].node->getStats().files == 3, test, "du of /a has " + to_string(entries[0].node->getStats().files) + " files");
+	check(vfs.size("/a") == entries[0].node->getSize(), test, "size and du of /a differ");
+	check(vfs.size("/a/b") == 10 + 8192, test, "/a/b has " + to_string(vfs.size("/a/b")) + " bytes");
+	check(vfs.physicalSize("/a") == physical, test, "the links added physical bytes");
+
+	// growing the file grows each folder once
+	vfs.write("x.txt", 8192, string(100, 'x'));
+	check(vfs.size("/a") == 10 + 10 + 8292, test, "/a has " + to_string(vfs.size("/a")) + " bytes after a write");
+	check(vfs.size("/a/b") == 10 + 8292, test, "/a/b has " + to_string(vfs.size("/a/b")) + " bytes after a write");
+
+	// a folder keeps the bytes until its last name of the file goes
+	vfs.rm("y.txt");
+	check(vfs.size("/a") == 10 + 10 + 8292, test, "/a has " + to_string(vfs.size("/a")) + " bytes after rm");
+	vfs.cd("b");
+	vfs.rm("z.txt");
+	check(vfs.size("/a/b") == 10, test, "/a/b has " + to_string(vfs.size("/a/b")) + " bytes after rm");
+	check(vfs.size("/a") == 10 + 10 + 8292, test, "/a has " + to_string(vfs.size("/a")) + " bytes after the second rm");
+	vfs.recover();
+	vfs.recover();
+	check(vfs.size("/a/b") == 10 + 8292, test, "/a/b has " + to_string(vfs.size("/a/b")) + " bytes after recover");
+	check(vfs.size("/a") == 10 + 10 + 8292, test, "/a has " + to_string(vfs.size("/a")) + " bytes after recover");
+
+	// a rolled back link leaves the sizes as they were
+	vfs.cd("/a");
+	vfs.begin();
+	vfs.mkdir("c");
+	vfs.ln("x.txt", "c/w.txt", false);
+	check(vfs.size("/a/c") == 10 + 8292, test, "/a/c has " + to_string(vfs.size("/a/c")) + " bytes in the transaction");
+	vfs.abort();
+	check(vfs.size("/a") == 10 + 10 + 8292, test, "/a has " + to_string(vfs.size("/a")) + " bytes after abort");
+}
+
+// a byte quota is not charged for a name of a file the folder already holds
+void testQuotaSkipsHeldLinks()
+{
+	string test = "quota skips held links";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.write("x.txt", 0, string(8192, 'x'));
+	vfs.quota("-b " + to_string(vfs.size("/a")) + " /a");
+
+	// a new name of x.txt adds no bytes to /a
+	check(!throws([&]() { vfs.ln("x.txt", "y.txt", false); }), test, "ln was refused by the byte quota");
+	check(throws([&]() { vfs.touch("big.txt", 1); }), test, "touch passed the byte quota");
+
+	// moving a name into a folder already holding the file adds no bytes to it
+	vfs.cd("/");
+	vfs.mkdir("c");
+	vfs.ln("/a/x.txt", "/c/v.txt", false);
+	vfs.quota("-b " + to_string(vfs.size("/c")) + " /c");
+	check(!throws([&]() { vfs.mv("/a/y.txt", "/c"); }), test, "mv was refused by the byte quota");
+	check(vfs.size("/c") == 10 + 8192, test, "/c has " + to_string(vfs.size("/c")) + " bytes");
+}
+
+// replacing the content of a file is one change, seen by a watch as one event
+void testOverwriteIsOneEvent()
+{
+	string test = "overwrite is one event";
+	VFS vfs;
+	vfs.write("x.txt", 0, "a longer first line\n");
+	WatchRing *ring = vfs.watchRing(vfs.watch("/"));
+
+	vfs.overwrite("x.txt", "short\n");
+
+	WatchEvent batch[WATCH_BATCH];
+	int count = ring->pop(batch, WATCH_BATCH);
+	check(count == 1 && batch[0].type == watch_modified && batch[0].count == 1, test, "the watch took " + to_string(count) + " events");
+	check(vfs.size("x.txt") == 6, test, "x.txt has " + to_string(vfs.size("x.txt")) + " bytes");
+}
+
+// returns the root hash of a tree file
+uint64_t rootHash(const string &filename)
+{
+	ifstream in(filename);
+	Vector<DatEntry> entries;
+	readTree(in, entries);
+	return entries[0].hash;
+}
+
+// a tree made equal by sync hashes equal to the file it was synced to, although its nodes were
+// created at other times, so the next diff stops at the root
+void testSyncedTreeHashesEqual()
+{
+	string test = "synced tree hashes equal";
+	{
+		VFS source;
+		source.mkdir("a");
+		source.cd("a");
+		source.mkdir("b");
+		source.touch("x.txt", 5);
+		source.save("source.dat", false);
+	}
+
+	// the synced tree starts with other nodes, made a few ticks of the coarse clock later
+	usleep(50000);
+	VFS vfs;
+	vfs.mkdir("c");
+	vfs.touch("y.txt", 7);
+	vfs.sync("source.dat");
+	vfs.save("synced.dat", false);
+
+	check(vfs.diff("source.dat").empty(), test, "the synced tree still differs");
+	check(rootHash("synced.dat") == rootHash("source.dat"), test, "the root hashes differ");
+
+	unlink("source.dat");
+	unlink("synced.dat");
+}
+
+// returns true if a diff holds a change of the given kind at path
+bool hasChange(const Vector<DiffEntry> &changes, char change, const string &path)
+{
+	for(int i = 0; i < changes.size(); i++)
+	{
+		if(changes[i].change == change && changes[i].path == path)	return true;
+	}
+	return false;
+}
+
+// a snapshot keeps the tree it was taken of while the tree changes around it, folders with many
+// children included, and a restored tree changes without touching the snapshot
+void testSnapshotKeepsTree()
+{
+	string test = "snapshot keeps tree";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.mkdir("b");
+	vfs.cd("a");
+	for(int i = 0; i < 200; i++)
+	{
+		vfs.touch("f" + to_string(i), 10);
+	}
+	vfs.write("x", 0, "before");
+	vfs.cd("/b");
+	vfs.touch("y", 5);
+	vfs.snapshotCreate("s1");
+
+	vfs.rm("y");
+	vfs.cd("/a");
+	vfs.write("x", 0, "after the change");
+	vfs.touch("n", 1);
+	vfs.mv("/a/f7", "/b/f7");
+	vfs.cd("/");
+	vfs.mkdir("c");
+	vfs.snapshotCreate("s2");
+	vfs.truncate("/a/f3", 20);
+
+	// each version sees the changes made after it, and none before
+	Vector<DiffEntry> changes = vfs.snapshotDiff("s1", "s2");
+	check(changes.size() == 6, test, "s1 to s2 has " + to_string(changes.size()) + " changes");
+	check(hasChange(changes, '~', "/a/x") && hasChange(changes, '+', "/a/n") && hasChange(changes, '-', "/b/y") &&
+		  hasChange(changes, '-', "/a/f7") && hasChange(changes, '+', "/b/f7") && hasChange(changes, '+', "/c"),
+		  test, "s1 to s2 misses a change");
+	changes = vfs.snapshotDiff("s2", "");
+	check(changes.size() == 1 && hasChange(changes, '~', "/a/f3"), test, "s2 to the tree has " + to_string(changes.size()) + " changes");
+
+	// the restored tree is the first version, and changing it leaves the snapshot as it was
+	vfs.snapshotDelete("s2");
+	vfs.snapshotRestore("s1");
+	check(vfs.size("/a/x") == 6 && vfs.size("/b/y") == 5 && vfs.size("/a/f3") == 10, test, "the restored tree has other sizes");
+	check(throws([&]() { vfs.size("/a/n"); }) && throws([&]() { vfs.size("/c"); }), test, "the restored tree has later nodes");
+
+	vfs.write("/b/y", 0, "changed");
+	vfs.cd("/a");
+	vfs.rm("f0");
+	changes = vfs.snapshotDiff("s1", "");
+	check(changes.size() == 2 && hasChange(changes, '~', "/b/y") && hasChange(changes, '-', "/a/f0"), test,
+		  "s1 to the restored tree has " + to_string(changes.size()) + " changes");
+}
+
+// a transaction rolled back leaves the tree, its sizes and the bin as they were, and a committed one
+// keeps its changes
+void testAbortRestoresTree()
+{
+	string test = "abort restores tree";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.write("x.txt", 0, "hello");
+	vfs.mkdir("b");
+	uint64_t before = vfs.size("/");
+
+	vfs.begin();
+	vfs.write("x.txt", 5, " world");
+	vfs.mv("b", "c");
+	vfs.touch("y.txt", 100);
+	vfs.rm("x.txt");
+	vfs.abort();
+
+	check(vfs.size("/") == before, test, "the root has " + to_string(vfs.size("/")) + " bytes after abort");
+	check(vfs.resolve("/a/b") != nullptr && vfs.resolve("/a/c") == nullptr, test, "the rename was kept");
+	check(vfs.resolve("/a/y.txt") == nullptr, test, "the new file was kept");
+	check(vfs.resolve("/a/x.txt") != nullptr && vfs.size("/a/x.txt") == 5, test, "x.txt did not get its content back");
+	check(throws([&]() { vfs.recover(); }), test, "the bin kept the removed file");
+
+	vfs.begin();
+	vfs.touch("y.txt", 100);
+	vfs.commit();
+	check(vfs.size("/") == before + 100, test, "the root has " + to_string(vfs.size("/")) + " bytes after commit");
+}
+
+// a copy-on-write copy and its source change apart, whichever one is written first
+void testCowCopyIsIndependent()
+{
+	string test = "cow copy is independent";
+	VFS vfs;
+	vfs.mkdir("s");
+	vfs.cd("s");
+	vfs.write("f.txt", 0, "abc");
+	vfs.mkdir("sub");
+	vfs.cd("sub");
+	vfs.touch("g.txt", 7);
+	vfs.cd("/");
+	vfs.cp("s", "t", true, true);
+	check(vfs.size("/t") == vfs.size("/s"), test, "the copy has " + to_string(vfs.size("/t")) + " bytes");
+
+	// a write to the copy leaves the source alone
+	vfs.write("/t/f.txt", 3, "def");
+	check(vfs.size("/t/f.txt") == 6 && vfs.size("/s/f.txt") == 3, test, "the write reached the source");
+
+	// changes to the source leave the copy alone
+	vfs.cd("/s/sub");
+	vfs.touch("h.txt", 4);
+	vfs.rm("g.txt");
+	check(vfs.resolve("/t/sub/h.txt") == nullptr, test, "the new file of the source is in the copy");
+	check(vfs.resolve("/t/sub/g.txt") != nullptr, test, "the removal reached the copy");
+	check(vfs.size("/t") == 10 + 6 + 10 + 7, test, "the copy has " + to_string(vfs.size("/t")) + " bytes after the changes");
+	check(vfs.size("/s") == 10 + 3 + 10 + 4, test, "the source has " + to_string(vfs.size("/s")) + " bytes after the changes");
+}
+
+// a folder cannot be moved into its own subtree
+void testMvIntoDescendantFails()
+{
+	string test = "mv into descendant fails";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.cd("a");
+	vfs.mkdir("b");
+	vfs.cd("/");
+
+	check(throws([&]() { vfs.mv("a", "a/b"); }), test, "a moved into its child");
+	check(throws([&]() { vfs.mv("a", "a/b/c"); }), test, "a moved under a new name into its child");
+	check(throws([&]() { vfs.mv("a", "a"); }), test, "a moved into itself");
+	check(vfs.resolve("/a/b") != nullptr && vfs.resolve("/a/b/c") == nullptr, test, "the tree changed");
+	check(vfs.size("/") == 20, test, "the root has " + to_string(vfs.size("/")) + " bytes");
+}
+
+// byte and node quotas refuse every way of growing a folder past them, and dropping them lets it grow
+void testQuotaRefusesGrowth()
+{
+	string test = "quota refuses growth";
+	VFS vfs;
+	vfs.mkdir("q");
+	vfs.quota("-b 100 -n 3 /q");
+	vfs.cd("q");
+
+	check(!throws([&]() { vfs.touch("a.txt", 50); }), test, "a file within the quota was refused");
+	check(throws([&]() { vfs.touch("b.txt", 60); }), test, "touch passed the byte quota");
+	check(throws([&]() { vfs.write("a.txt", 50, string(60, 'x')); }), test, "write passed the byte quota");
+	check(!throws([&]() { vfs.touch("c.txt", 10); }), test, "a second file was refused");
+	check(!throws([&]() { vfs.mkdir("d"); }), test, "a folder within the node quota was refused");
+	check(throws([&]() { vfs.touch("e.txt", 1); }), test, "touch passed the node quota");
+
+	// growth from outside is refused too
+	vfs.cd("/");
+	vfs.touch("big.txt", 80);
+	check(throws([&]() { vfs.mv("big.txt", "q"); }), test, "mv passed the quota");
+	check(throws([&]() { vfs.cp("big.txt", "q/copy.txt", false, false); }), test, "cp passed the quota");
+	check(vfs.resolve("/big.txt") != nullptr, test, "the refused move took the file");
+
+	vfs.quota("-b 0 -n 0 /q");
+	check(!throws([&]() { vfs.mv("big.txt", "q"); }), test, "mv was refused without a quota");
+}
+
+// searches a folder of one client, noting when the search starts and ends
+Task<void> searchFolder(AsyncVFS &async, Session &session, Vector<string> &found, Vector<string> &order)
+{
+	co_await async.cd(session, "/a");
+	order.push_back("find started");
+	found = co_await async.find("target.txt");
+	order.push_back("find done");
+}
+
+// removes a folder of another client, empties the bin and saves the tree, noting each step
+Task<void> purgeAndSave(AsyncVFS &async, Session &session, Vector<string> &order)
+{
+	co_await async.cd(session, "/b");
+	co_await async.rm(session, "junk");
+	order.push_back("rm done");
+	co_await async.emptybin();
+	order.push_back("emptybin done");
+	co_await async.touch(session, "new.txt", 5);
+	co_await async.save("async.dat");
+	order.push_back("save done");
+}
+
+// returns the position of a step in the order the tasks took, -1 if it never happened
+int stepAt(const Vector<string> &order, const string &step)
+{
+	for(int i = 0; i < order.size(); i++)
+	{
+		if(order[i] == step)	return i;
+	}
+	return -1;
+}
+
+// two clients share one tree on one scheduler thread: a search yields while the other client
+// removes nodes, the bin waits for the search before deleting, and the save sees the later changes
+void testAsyncSessionsInterleave()
+{
+	string test = "async sessions interleave";
+	VFS vfs;
+	vfs.mkdir("a");
+	vfs.mkdir("b");
+	vfs.cd("/a");
+	for(int i = 0; i < 3 * ASYNC_SLICE; i++)	vfs.touch("f" + to_string(i) + ".txt", 1);
+	vfs.touch("target.txt", 1);
+	vfs.cd("/b");
+	vfs.touch("target.txt", 1);
+	vfs.mkdir("junk");
+	vfs.cd("junk");
+	for(int i = 0; i < 3 * ASYNC_SLICE; i++)	vfs.touch("j" + to_string(i) + ".txt", 1);
+
+	Scheduler scheduler;
+	AsyncVFS async(vfs, scheduler);
+	Session first = {"", "", 1};
+	Session second = {"", "", 2};
+	Vector<string> found;
+	Vector<string> order;
+
+	scheduler.spawn(searchFolder(async, first, found, order));
+	scheduler.spawn(purgeAndSave(async, second, order));
+	scheduler.run();
+
+	// the removal ran while the search was suspended, and the bin waited for the search
+	check(stepAt(order, "save done") >= 0, test, "the second client did not finish");
+	check(stepAt(order, "rm done") >= 0 && stepAt(order, "rm done") < stepAt(order, "find done"), test, "the search did not yield to the other client");
+	check(stepAt(order, "find done") < stepAt(order, "emptybin done"), test, "the bin was emptied during the search");
+
+	bool first_target = false;
+	bool second_target = false;
+	for(int i = 0; i < found.size(); i++)
+	{
+		first_target = first_target || found[i] == "/a/target.txt";
+		second_target = second_target || found[i] == "/b/target.txt";
+	}
+	check(first_target && second_target, test, "find returned " + to_string(found.size()) + " paths");
+
+	// each client kept its own folder
+	check(first.curr == "/a" && second.curr == "/b", test, "the sessions are in " + first.curr + " and " + second.curr);
+
+	// the saved tree has the file made after the bin was emptied, and not the purged folder
+	ifstream input("async.dat");
+	string line;
+	bool saved_new = false;
+	bool saved_junk = false;
+	while(getline(input, line))
+	{
+		saved_new = saved_new || line.rfind("/b/new.txt,", 0) == 0;
+		saved_junk = saved_junk || line.rfind("/b/junk", 0) == 0;
+	}
+	check(saved_new && !saved_junk, test, "the saved tree missed the changes");
+	check(throws([&]() { vfs.recover(); }), test, "the bin was not emptied");
+
+	unlink("async.dat");
+}
+
+int main()
+{
+	// a fresh tree is wanted, so the tree never loads a vfs.dat found in the working folder
+	char folder[] = "/tmp/vfstestXXXXXX";
+	if(mkdtemp(folder) == nullptr || chdir(folder) != 0)
+	{
+		cerr<<"cannot create a scratch folder"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	testRecoverSkipsLostNode();
+	testAbortRestoresSkip();
+	testTransactionRefusesOtherClients();
+	testSessionEndDropsWatches();
+	testEmptybinLeavesRemovedFolder();
+	testEmptybinOutlivesOldFolder();
+	testSyncedTreeHashesEqual();
+	testLargestFileFollowsChanges();
+	testNameIndexFollowsChanges();
+	testDuCountsFileOnce();
+	testQuotaSkipsHeldLinks();
+	testOverwriteIsOneEvent();
+	testSnapshotKeepsTree();
+	testAbortRestoresTree();
+	testCowCopyIsIndependent();
+	testMvIntoDescendantFails();
+	testQuotaRefusesGrowth();
+	testAsyncSessionsInterleave();
+
+	rmdir(folder);
+
+	if(failures > 0)
+	{
+		cout<<failures<<" checks failed"<<endl;
+		return(EXIT_FAILURE);
+	}
+	cout<<"all tests passed"<<endl;
+	return(EXIT_SUCCESS);
+}
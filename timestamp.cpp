@@ -0,0 +1,88 @@
+#include<ctime>
+#include<cstdlib>
+#include<atomic>
+#include "timestamp.hpp"
+
+// returns the current time, never earlier than a time returned before
+// -- the coarse clock is refreshed by the kernel once per tick, so reading it is as cheap as a load
+uint64_t timestampNow() {
+    static atomic<uint64_t> last(0);
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    uint64_t timestamp = uint64_t(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+
+    // keeps the latest time handed out, so a clock set back does not reorder nodes
+    uint64_t previous = last.load(memory_order_relaxed);
+    while (timestamp > previous && !last.compare_exchange_weak(previous, timestamp, memory_order_relaxed)) { }
+
+    return (timestamp > previous) ? timestamp : previous;
+}
+
+// returns the ctime text of a timestamp in local time, without the line break
+string formatTimestamp(uint64_t timestamp) {
+    // text of the last second this thread formatted
+    thread_local time_t cached_second = -1;
+    thread_local string cached_text;
+
+    time_t second = timestamp / 1000000000ULL;
+    if (second != cached_second) {
+        tm local;
+        char text[64];
+
+        localtime_r(&second, &local);
+        strftime(text, sizeof(text), "%a %b %e %H:%M:%S %Y", &local);
+
+        cached_second = second;
+        cached_text = text;
+    }
+
+    return cached_text;
+}
+
+// parses the ctime text of older vfs.dat files, returns false if text is not one
+bool parseTimestamp(const string &text, uint64_t &timestamp) {
+    tm local = {};
+    const char* end = strptime(text.c_str(), "%a %b %d %H:%M:%S %Y", &local);
+
+    // only a trailing line break may follow the text
+    if (end == nullptr || (*end != '\0' && *end != '\n')) {
+        return false;
+    }
+
+    // lets mktime work out daylight saving time
+    local.tm_isdst = -1;
+    time_t second = mktime(&local);
+    if (second < 0) {
+        return false;
+    }
+
+    timestamp = uint64_t(second) * 1000000000ULL;
+    return true;
+}
+
+// parses the time fields of a vfs.dat line
+void parseTimes(const string &text, uint64_t &created, uint64_t &modified, uint64_t &accessed) {
+    created = modified = accessed = 0;
+
+    // older files hold one ctime text, the same one for nodes made together, so the last one is kept
+    if (text.empty() || text[0] < '0' || text[0] > '9') {
+        thread_local string cached_text;
+        thread_local uint64_t cached_time = 0;
+
+        if (text != cached_text) {
+            cached_text = text;
+            if (!parseTimestamp(text, cached_time)) {
+                cached_time = 0;
+            }
+        }
+
+        created = modified = accessed = cached_time;
+        return;
+    }
+
+    char* end;
+    created = strtoull(text.c_str(), &end, 10);
+    modified = (*end == ',') ? strtoull(end + 1, &end, 10) : created;
+    accessed = (*end == ',') ? strtoull(end + 1, &end, 10) : modified;
+}
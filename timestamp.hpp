@@ -0,0 +1,28 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include<string>
+#include<cstdint>
+
+using namespace std;
+
+// ---------------- Timestamps -------------------------
+// a timestamp is a count of nanoseconds since the epoch. The clock read is the coarse kernel clock,
+// which the kernel refreshes once per tick and which is read without a system call; the last value
+// handed out is kept, so timestamps never go backwards. Text is only made when a timestamp is shown.
+
+// returns the current time, never earlier than a time returned before
+uint64_t timestampNow();
+
+// returns the ctime text of a timestamp in local time, without the line break
+// -- each thread keeps the text of the last second it formatted, so nodes made together cost one format
+string formatTimestamp(uint64_t timestamp);
+
+// parses the ctime text of older vfs.dat files, returns false if text is not one
+bool parseTimestamp(const string &text, uint64_t &timestamp);
+
+// parses the time fields of a vfs.dat line: created,modified,accessed in nanoseconds, or the single
+// ctime text of older files, used for all three; text that is neither gives 0
+void parseTimes(const string &text, uint64_t &created, uint64_t &modified, uint64_t &accessed);
+
+#endif
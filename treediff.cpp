@@ -0,0 +1,304 @@
+#include<algorithm>
+#include<stdexcept>
+#include "treediff.hpp"
+#include "skiplist.hpp"
+#include "datfile.hpp"
+#include "timestamp.hpp"
+
+// scrambles a 64-bit value so nearby inputs give unrelated hashes
+static uint64_t mixHash(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// returns the FNV-1a hash of a string
+static uint64_t hashString(const string &text) {
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < text.size(); i++) {
+        value = (value ^ (unsigned char)text[i]) * 0x100000001b3ULL;
+    }
+    return value;
+}
+
+// returns the path of a child of the folder at path
+string childPath(const string &path, const string &name) {
+    return (path == "/") ? "/" + name : path + '/' + name;
+}
+
+// returns one line describing a change: + added, - removed, ~ resized, > moved
+string formatChange(const TreeChange &change) {
+    switch (change.type) {
+        case change_added:
+            return "+ " + change.path + '\n';
+        case change_removed:
+            return "- " + change.path + '\n';
+        case change_resized:
+            return "~ " + change.path + '\n';
+        default:
+            return "> " + change.path + " -> " + change.to + '\n';
+    }
+}
+
+// adds the node at path to a tree being read in preorder
+// -- open holds the folders whose subtree is still being read, so the last one is the parent
+static void addEntry(Vector<DatEntry> &entries, Vector<int> &open, const string &path, uint64_t size, NodeType type, uint64_t time_created, const string &target) {
+    if (path.empty() || path[0] != '/') {
+        throw runtime_error("Invalid tree file");
+    }
+
+    // the depth is the number of folders above the node
+    int depth = (path == "/") ? 0 : count(path.begin(), path.end(), '/');
+
+    // the first line is the root and every other node sits at most one level below the last folder
+    if ((entries.empty() && path != "/") || (!entries.empty() && (depth == 0 || depth > open.size()))) {
+        throw runtime_error("Invalid tree file");
+    }
+
+    // closes the subtrees that end before this node
+    while (open.size() > depth) {
+        entries[open.back()].end = entries.size();
+        open.erase(open.size() - 1);
+    }
+
+    DatEntry entry;
+    entry.name = (depth == 0) ? path : path.substr(path.find_last_of('/') + 1);
+    entry.size = size;
+    entry.type = type;
+    entry.time_created = time_created;
+    entry.target = target;
+    entry.parent = open.empty() ? -1 : open.back();
+    entry.end = 0;
+
+    open.push_back(entries.size());
+    entries.push_back(entry);
+}
+
+// reads a tree in the vfs.dat format, text or compressed, into entries and hashes it
+// -- the lines are in preorder, so a stack of open folders gives every entry its parent
+void readTree(istream &in, Vector<DatEntry> &entries) {
+    // variables for one line and the folders whose subtree is still being read
+    string line;
+    Vector<int> open;
+
+    if (isCompressedDat(in)) {
+        DatReader reader;
+        reader.open(in);
+        reader.decodeAll();
+
+        DatRecord record;
+        while (reader.next(record)) {
+            addEntry(entries, open, record.path, record.size, record.type, record.time_created, record.target);
+        }
+    }
+    else {
+        while (getline(in, line)) {
+            // splits path,size,type,times
+            size_t first = line.find(',');
+            size_t second = (first == string::npos) ? first : line.find(',', first + 1);
+            size_t third = (second == string::npos) ? second : line.find(',', second + 1);
+
+            if (third == string::npos) {
+                throw runtime_error("Invalid tree file");
+            }
+
+            // only the creation time takes part in the diff
+            uint64_t created, modified, accessed;
+            string times = line.substr(third + 1);
+            parseTimes(times, created, modified, accessed);
+
+            NodeType type = datType(stoi(line.substr(second + 1, third - second - 1)));
+            addEntry(entries, open, line.substr(0, first), stoull(line.substr(first + 1, second - first - 1)),
+                     type, created, (type == symbolic_link) ? datTarget(times) : "");
+        }
+    }
+
+    // closes the subtrees still open at the end
+    while (!open.empty()) {
+        entries[open.back()].end = entries.size();
+        open.erase(open.size() - 1);
+    }
+
+    if (entries.empty()) {
+        throw runtime_error("Invalid tree file");
+    }
+
+    hashTree(entries);
+}
+
+// computes the hashes of a flattened tree whose entries are in preorder
+// -- children come after their parent, so one backward pass sees every child before its parent;
+// -- the children are summed, so their order does not change the hash;
+// -- only what diffFolders compares is hashed, so a tree made equal by sync hashes equal although
+//    its nodes have other creation times
+void hashTree(Vector<DatEntry> &entries) {
+    // sum of the hashes of the children of each entry
+    Vector<uint64_t> sums;
+    for (int i = 0; i < entries.size(); i++) {
+        sums.push_back(0);
+    }
+
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        DatEntry &entry = entries[i];
+
+        entry.content = mixHash(mixHash(mixHash(entry.type) ^ entry.size ^ hashString(entry.target)) + sums[i]);
+        entry.hash = mixHash(entry.content ^ hashString(entry.name));
+
+        if (entry.parent >= 0) {
+            sums[entry.parent] += entry.hash;
+        }
+    }
+}
+
+// collects the indices of the children of the folder at index, ordered by name
+static void sortedChildren(Vector<DatEntry> &entries, int index, Vector<int> &children) {
+    // the children follow the folder, each one after the subtree of the previous
+    for (int i = index + 1; i < entries[index].end; i = entries[i].end) {
+        children.push_back(i);
+    }
+
+    if (children.size() > 1) {
+        sort(&children[0], &children[0] + children.size(), [&entries](int a, int b) {
+            return entries[a].name < entries[b].name;
+        });
+    }
+}
+
+// adds the differences between the folder at i in from and the folder at j in to
+static void diffFolders(Vector<DatEntry> &from, int i, Vector<DatEntry> &to, int j, const string &path, Vector<TreeChange> &changes) {
+    // identical subtrees are skipped without visiting them
+    if (from[i].content == to[j].content) {
+        return;
+    }
+
+    // pairs up the children by name
+    Vector<int> left;
+    Vector<int> right;
+    sortedChildren(from, i, left);
+    sortedChildren(to, j, right);
+
+    int l = 0;
+    int r = 0;
+    while (l < left.size() || r < right.size()) {
+        // a name only on one side was removed or added
+        if (r == right.size() || (l < left.size() && from[left[l]].name < to[right[r]].name)) {
+            TreeChange change = {change_removed, childPath(path, from[left[l]].name), "", left[l], -1};
+            changes.push_back(change);
+            l++;
+        }
+        else if (l == left.size() || to[right[r]].name < from[left[l]].name) {
+            TreeChange change = {change_added, childPath(path, to[right[r]].name), "", -1, right[r]};
+            changes.push_back(change);
+            r++;
+        }
+        // a name on both sides is compared, folders recursively
+        else {
+            DatEntry &before = from[left[l]];
+            DatEntry &after = to[right[r]];
+
+            if (before.type != after.type || (before.type == file && before.size != after.size) ||
+                (before.type == symbolic_link && before.target != after.target)) {
+                TreeChange change = {change_resized, childPath(path, after.name), "", left[l], right[r]};
+                changes.push_back(change);
+            }
+            else if (before.type == folder) {
+                diffFolders(from, left[l], to, right[r], childPath(path, after.name), changes);
+            }
+
+            l++;
+            r++;
+        }
+    }
+}
+
+// finds the differences from one flattened tree to another
+// -- a removed and an added subtree with the same content are reported as one move
+void diffTrees(Vector<DatEntry> &from, Vector<DatEntry> &to, Vector<TreeChange> &changes) {
+    Vector<TreeChange> found;
+    diffFolders(from, 0, to, 0, "/", found);
+
+    // removed subtrees by content, holding indices into found
+    SkipList<uint64_t, int> removed;
+    for (int i = 0; i < found.size(); i++) {
+        if (found[i].type == change_removed) {
+            removed.insert(from[found[i].from_index].content, i);
+        }
+    }
+
+    // an added subtree with the content of a removed one was moved
+    for (int i = 0; i < found.size(); i++) {
+        if (found[i].type != change_added) {
+            continue;
+        }
+
+        uint64_t content = to[found[i].to_index].content;
+        SkipList<uint64_t, int>::Entry* match = removed.lowerBound(content);
+
+        if (match != nullptr && match->key == content) {
+            int source = match->value;
+            removed.erase(match->key, source);
+
+            found[source].type = change_moved;
+            found[source].to = found[i].path;
+            found[source].to_index = found[i].to_index;
+            found[i].to_index = -1;
+        }
+    }
+
+    // keeps every change that was not merged into a move
+    for (int i = 0; i < found.size(); i++) {
+        if (found[i].type != change_added || found[i].to_index >= 0) {
+            changes.push_back(found[i]);
+        }
+    }
+}
+
+// adds the steps creating the subtree at index of to inside the folder at dir
+static void planCreate(Vector<DatEntry> &to, int index, const string &dir, Vector<SyncStep> &steps) {
+    SyncStep step = {(to[index].type == folder) ? sync_mkdir : sync_touch, dir, to[index].name, to[index].size, ""};
+    if (to[index].type == symbolic_link) {
+        step.op = sync_symlink;
+        step.target = to[index].target;
+    }
+    steps.push_back(step);
+
+    // the children follow the node, each one after the subtree of the previous
+    for (int i = index + 1; i < to[index].end; i = to[i].end) {
+        planCreate(to, i, childPath(dir, to[index].name), steps);
+    }
+}
+
+// returns the folder holding the node at path
+static string parentPath(const string &path) {
+    size_t found = path.find_last_of('/');
+    return (found == 0) ? "/" : path.substr(0, found);
+}
+
+// turns the differences into the mutations that make the old tree match the new one
+// -- moves run first, while the subtrees they take from are still there, then removals, then creations
+void planSync(Vector<DatEntry> &to, Vector<TreeChange> &changes, Vector<SyncStep> &steps) {
+    for (int i = 0; i < changes.size(); i++) {
+        if (changes[i].type == change_moved) {
+            SyncStep step = {sync_mv, changes[i].path, changes[i].to, 0, ""};
+            steps.push_back(step);
+        }
+    }
+
+    // a resized file is replaced
+    for (int i = 0; i < changes.size(); i++) {
+        if (changes[i].type == change_removed || changes[i].type == change_resized) {
+            string path = changes[i].path;
+            SyncStep step = {sync_rm, parentPath(path), path.substr(path.find_last_of('/') + 1), 0, ""};
+            steps.push_back(step);
+        }
+    }
+
+    for (int i = 0; i < changes.size(); i++) {
+        if (changes[i].type == change_added || changes[i].type == change_resized) {
+            planCreate(to, changes[i].to_index, parentPath(changes[i].path), steps);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef TREEDIFF_H
+#define TREEDIFF_H
+
+#include<iostream>
+#include<string>
+#include<cstdint>
+#include "node.hpp"
+#include "vector.hpp"
+
+using namespace std;
+
+// ---------------- Diff and sync of two trees in the vfs.dat format -------------------------
+// a tree is read in one pass into a flat preorder array, without building nodes; every entry
+// gets a Merkle hash of its subtree, so the diff skips identical subtrees without visiting them
+
+// one node of a flattened tree, in preorder
+struct DatEntry {
+	string name;			//name of the node, "/" for the root
+	NodeType type;			//type of the node
+	uint64_t size;			//size of the node
+	uint64_t time_created;	//creation time of the node, in nanoseconds, not hashed
+	string target;			//path held by a symbolic link, empty for other nodes
+	int parent;				//index of the parent, -1 for the root
+	int end;				//index just past the subtree of the node
+	uint64_t content;		//hash of the node without its name: type, size, link path and children
+	uint64_t hash;			//hash of the node with its name
+};
+
+// kinds of difference between two trees
+enum ChangeType {
+	change_added,			//only in the new tree
+	change_removed,			//only in the old tree
+	change_resized,			//a file whose size or type changed, or a link whose path changed
+	change_moved,			//the same subtree under another path or name
+};
+
+// one difference between two trees
+struct TreeChange {
+	ChangeType type;		//kind of difference
+	string path;			//path in the old tree, or in the new tree if added
+	string to;				//path in the new tree of a moved node
+	int from_index;			//entry in the old tree, -1 if added
+	int to_index;			//entry in the new tree, -1 if removed
+};
+
+// kinds of mutation used to sync a tree
+enum SyncOp {
+	sync_mkdir,				//creates folder name in dir
+	sync_touch,				//creates file name of size bytes in dir
+	sync_symlink,			//creates symbolic link name holding target in dir
+	sync_rm,				//removes name from dir
+	sync_mv,				//moves dir to name
+};
+
+// one mutation of a sync, in the order it has to run
+struct SyncStep {
+	SyncOp op;				//kind of mutation
+	string dir;				//folder the mutation runs in, or the source of a move
+	string name;			//name of the node, or the destination of a move
+	uint64_t size;			//size of a created file
+	string target;			//path held by a created symbolic link
+};
+
+// reads a tree in the vfs.dat format, text or compressed, into entries and hashes it
+void readTree(istream &in, Vector<DatEntry> &entries);
+
+// computes the hashes of a flattened tree whose entries are in preorder
+void hashTree(Vector<DatEntry> &entries);
+
+// finds the differences from one flattened tree to another
+// -- a removed and an added subtree with the same content are reported as one move
+void diffTrees(Vector<DatEntry> &from, Vector<DatEntry> &to, Vector<TreeChange> &changes);
+
+// turns the differences into the mutations that make the old tree match the new one
+// -- moves run first, then removals, then creations
+void planSync(Vector<DatEntry> &to, Vector<TreeChange> &changes, Vector<SyncStep> &steps);
+
+// returns one line describing a change: + added, - removed, ~ resized, > moved
+string formatChange(const TreeChange &change);
+
+// returns the path of a child of the folder at path
+string childPath(const string &path, const string &name);
+
+#endif
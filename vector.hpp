@@ -15,7 +15,11 @@ class Vector
 		int v_capacity;					//capacity of vector
 	public:
 		Vector(int cap=0);			//Constructor
+		Vector(const Vector& other);	//Copy constructor
+		Vector(Vector&& other);			//Move constructor
 		~Vector();					//Destructor
+		Vector& operator=(const Vector& other);	//Copy assignment
+		Vector& operator=(Vector&& other);		//Move assignment
 		int size() const;				//Return current size of vector
 		int capacity() const;			//Return capacity of vector
 		bool empty() const; 			//Rturn true if the vector is empty, False otherwise
@@ -25,8 +29,10 @@ class Vector
 		void insert(int index, T element); //Add an element at the index 
 		void erase(int index);			//Removes an element from the index
 		T& operator[](int index);			//Returns the reference of an element at given index
+		const T& operator[](int index) const;	//Returns the reference of an element of a const vector
 		T& at(int index); 				//return reference of the element at given index
 		void shrink_to_fit();			//Reduce vector capacity to fit its size
+		void clear();					//Removes every element, keeping the capacity
 		void display();
     protected:
 		void reserve(int newCap);		//copies current data into an extended array
@@ -40,12 +46,59 @@ Vector<T>::Vector(int cap) : v_size(0), v_capacity(cap) {
 	data = new T[v_capacity];								// allocating cap size array to data
 }
 
+// copy constructor of vector class
+template <typename T>
+Vector<T>::Vector(const Vector& other) : v_size(other.v_size), v_capacity(other.v_size) {
+	data = new T[v_capacity];								// allocating an array for the copied elements
+
+	// copies elements from other
+	for (int i = 0; i < v_size; i++) {
+		data[i] = other.data[i];
+	}
+}
+
+// move constructor of vector class
+template <typename T>
+Vector<T>::Vector(Vector&& other) : data(other.data), v_size(other.v_size), v_capacity(other.v_capacity) {
+	// leaves other empty
+	other.data = new T[0];
+	other.v_size = 0;
+	other.v_capacity = 0;
+}
+
 // destructor of vector class
 template <typename T>
 Vector<T>::~Vector() {
 	delete [] data;											// deallocating memory assigned to data
 }
 
+// copy assignment of vector class
+template <typename T>
+Vector<T>& Vector<T>::operator=(const Vector& other) {
+	if (this != &other) {
+		Vector copy(other);
+		*this = static_cast<Vector&&>(copy);
+	}
+	return *this;
+}
+
+// move assignment of vector class
+template <typename T>
+Vector<T>& Vector<T>::operator=(Vector&& other) {
+	if (this != &other) {
+		// swaps the arrays so other deallocates the old one
+		T* temp = data;
+		data = other.data;
+		other.data = temp;
+
+		v_size = other.v_size;
+		v_capacity = other.v_capacity;
+		other.v_size = 0;
+		other.v_capacity = 0;
+	}
+	return *this;
+}
+
 // returns current size of vector
 template <typename T>
 int Vector<T>::size() const {
@@ -166,6 +219,13 @@ T& Vector<T>::operator[](int index) {
 	return data[index];
 }
 
+// returns the reference of an element of a const vector at given index
+template <typename T>
+const T& Vector<T>::operator[](int index) const {
+	// returns element at index
+	return data[index];
+}
+
 // returns reference of the element at given index
 template <typename T>
 T& Vector<T>::at(int index) {
@@ -184,4 +244,10 @@ void Vector<T>::shrink_to_fit() {
 	reserve(size());
 }			
 
+// removes every element, keeping the capacity
+template <typename T>
+void Vector<T>::clear() {
+	v_size = 0;
+}
+
 #endif
\ No newline at end of file
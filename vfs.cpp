@@ -1,7 +1,8 @@
 #include "vfs.hpp"
 
 // constructor of the VFS class
-VFS::VFS() {
+VFS::VFS() : open_walks(0), in_transaction(false), session_id(0), transaction_owner(0), compressed_dat(false), dedup(true),
+             tag_epoch(1), cow_epoch(0), queued_bytes(0), queued_nodes(0), queued_links(0), next_watch(1), next_cookie(0) {
     // creates input file stream
     ifstream input("vfs.dat", ios::in);
 
@@ -11,7 +12,8 @@ VFS::VFS() {
     }
     else {
         // creates root node
-        root = new Node("/", nullptr, folder, 0, getTime());
+        root = new Node("/", nullptr, folder, 0, timestampNow());
+        indexNode(root, true);
 
         // sets current Node
         curr_Node = root;
@@ -27,35 +29,23 @@ VFS::VFS() {
 
 // destructor of the VFS class
 VFS::~VFS() {
+    // deletes nodes in the bin first, since they still point at their old parents in the tree
+    while (!bin.isEmpty()) {
+        removeNode(bin.dequeue());
+    }
+
     // removes all nodes including root
     removeNode(root);
 
-    // deletes nodes in the bin
-    while (!bin.isEmpty()) {
-        removeNode(bin.dequeue());
+    // deletes the snapshots
+    for (int i = 0; i < snapshots.size(); i++) {
+        removeNode(snapshots[i].root);
     }
-}
 
-// prints the available menu of commands
-void VFS::help() {
-    cout<<"List of available Commands:"<<endl
-		<<"help                     : Prints the available menu of commands"<<endl
-		<<"pwd                      : Prints the path of the current node"<<endl
-		<<"ls [sort]                : Prints the children of the current node"<<endl
-		<<"mkdir <foldername>       : Creates a folder under the current folder"<<endl
-		<<"touch <filename> <size>  : Creates a file under the current node with specified filename and size"<<endl
-		<<"cd [ foldername | .. | - | /my/path/name]   "<<endl
-        <<"    [foldername]         : Changes current node to the specified folder"<<endl
-        <<"    [..]                 : Changes current node to its parent folder"<<endl
-        <<"    [-]                  : Changes current node to the previous working folder"<<endl
-        <<"    [/my/path/name]      : Changes current node to the specified path if it exists"<<endl
-		<<"rm <foldername>|<filename>   : Removes the specified folder or file"<<endl
-        <<"find <foldername>|<filename> : Returns the path of the file or the folder if it exists"<<endl
-        <<"mv <filename> <foldername>   : Moves a file located under the current node, to the specified folder path"<<endl
-        <<"size <foldername>|<filename> : Returns the total size of the folder or file"<<endl
-		<<"showbin                  : Shows the oldest node of the bin"<<endl
-		<<"emptybin                 : Empties the bin"<<endl
-		<<"exit                     : The program exits"<<endl;
+    // the watches outlive their folders, so their consumers can read the end
+    for (int i = 0; i < watches.size(); i++) {
+        delete watches[i];
+    }
 }
 
 // prints the path of the current node
@@ -68,73 +58,187 @@ string VFS::pwd() {
     }
 }
 
-// prints the children of the current node
-void VFS::ls(string sort_param) {
-    // checks if the sort parameter was passed
-    if (sort_param == "sort") {
-        // temporary container for sorting children
-        Vector<Node*> temp;
+// opens a listing of the children of the current node, read with nextEntries
+// -- params: [sort] [-o offset] [-n limit] [prefix*]
+Listing VFS::ls(string params) {
+    // variables for the listing options
+    bool sorted = false;
+    int offset = 0;
+    int limit = -1;
+    string prefix;
 
-        // loops through children of the current node
-        for (int i = 0; i < curr_Node->children.size(); i++) {
-            temp.push_back(curr_Node->children[i]);
+    // parses the listing options
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        if (token == "sort") {
+            sorted = true;
         }
+        else if (token == "-o" || token == "-n") {
+            // reads the number following the option
+            int value;
+            if (!(sstr >> value) || value < 0) {
+                throw runtime_error("Invalid parameter");
+            }
 
-        // sorts nodes in the temp
-        bubbleSort(temp);
+            (token == "-o" ? offset : limit) = value;
+        }
+        else if (token.back() == '*') {
+            prefix = token.substr(0, token.size() - 1);
+        }
+        else {
+            throw runtime_error("Invalid parameter");
+        }
+    }
 
-        // prints the nodes in the temp
-        for (int i = 0; i < temp.size(); i++) {
-            // checks the type of the child
-            if (temp[i]->type == folder) {
-                cout << setw(4) << "dir" << " ";
-            }
-            else {
-                cout << setw(4) << "file" << " ";
+    // the listed sizes include the queued changes of a transaction
+    settleStats();
+
+    curr_Node->inode->time_accessed = timestampNow();
+
+    Listing listing;
+    listing.position = 0;
+    listing.remaining = limit;
+    listing.is_sorted = sorted;
+
+    // checks if the children have to be sorted
+    if (sorted) {
+        // collects the matching children
+        Node* batch[LIST_BATCH];
+        listing.cursor = openList(curr_Node, prefix, 0);
+        int count;
+        while ((count = nextBatch(listing.cursor, batch, LIST_BATCH)) > 0) {
+            for (int i = 0; i < count; i++) {
+                listing.sorted.push_back(batch[i]);
             }
+        }
+
+        // sorts the matching children and skips to the requested page
+        mergeSort(listing.sorted);
+        listing.position = min(offset, listing.sorted.size());
+    }
+    else {
+        // the children are read in place as the listing is consumed
+        // -- without a prefix the offset is a direct jump, so the first page does not depend on the folder size
+        listing.cursor = openList(curr_Node, prefix, offset);
+    }
+
+    return listing;
+}
+
+// fills batch with up to max entries of a listing and returns how many were written, 0 once it is done
+int VFS::nextEntries(Listing &listing, Node **batch, int max) {
+    // the limit of the listing caps the batch
+    if (listing.remaining >= 0) {
+        max = min(max, listing.remaining);
+    }
+
+    // variable for the number of nodes written
+    int count = 0;
 
-            cout << setw(15) << temp[i]->name 
-                << " " << setw(10) << temp[i]->size
-                << " " << setw(15) << temp[i]->time_created;
+    if (listing.is_sorted) {
+        while (count < max && listing.position < listing.sorted.size()) {
+            batch[count++] = listing.sorted[listing.position++];
         }
     }
-    else if (sort_param == ""){
-         // loops through the children of the current node and prints them
-        for (int i = 0; i < curr_Node->children.size(); i++) {
-            // checks the type of the child
-            if (curr_Node->children[i]->type == folder) {
-                cout << setw(4) << "dir" << " ";
-            }
-            else {
-                cout << setw(4) << "file" << " ";
+    else {
+        count = nextBatch(listing.cursor, batch, max);
+    }
+
+    if (listing.remaining > 0) {
+        listing.remaining -= count;
+    }
+
+    return count;
+}
+
+// opens a cursor over the children of a folder starting with prefix, skipping offset matches
+// -- the cursor reads the children in place and stays valid until the folder changes
+ListCursor VFS::openList(Node *ptr, string prefix, int offset) {
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    ListCursor cursor = {ptr, 0, prefix, false, ""};
+
+    // without a prefix every child matches, so the offset is a position
+    if (prefix.empty()) {
+        cursor.position = min(offset, ptr->children.size());
+        return cursor;
+    }
+
+    // the matches of a large folder are one run of its children by name, starting at the prefix
+    sortNames(ptr);
+    if (ptr->by_name != nullptr) {
+        cursor.by_name = true;
+        cursor.next_name = prefix;
+    }
+
+    // skips the first offset matches
+    Node* skipped[LIST_BATCH];
+    while (offset > 0) {
+        int count = nextBatch(cursor, skipped, min(LIST_BATCH, offset));
+        if (count == 0) {
+            break;
+        }
+        offset -= count;
+    }
+
+    return cursor;
+}
+
+// fills batch with up to max children from the cursor and returns how many were written
+int VFS::nextBatch(ListCursor &cursor, Node **batch, int max) {
+    // variables for the children and the number of nodes written
+    Vector<Node*>& children = cursor.folder->children;
+    int count = 0;
+
+    // the run of matches by name ends at the first child without the prefix
+    // -- each batch looks up where the last one stopped, so children added or removed in between
+    //    are seen or skipped; a folder that shrank below the index ends the cursor
+    if (cursor.by_name) {
+        if (cursor.folder->by_name == nullptr) {
+            return 0;
+        }
+
+        for (SkipList<NameKey, Node*>::Entry* entry = nameBound(cursor.folder, cursor.next_name);
+             entry != nullptr && count < max; entry = entry->next[0]) {
+            Node* child = entry->value;
+
+            if (child->name.compare(0, cursor.prefix.size(), cursor.prefix) != 0) {
+                break;
             }
+            batch[count++] = child;
 
-            cout << setw(15) << curr_Node->children[i]->name 
-                << " " << setw(10) << curr_Node->children[i]->size
-                << " " << setw(15) << curr_Node->children[i]->time_created;
-            
+            // the smallest name after the child's own
+            cursor.next_name = child->name + '\0';
         }
+
+        return count;
     }
-    else {
-        throw runtime_error("Invalid parameter");
+
+    // collects the children matching the prefix
+    while (count < max && cursor.position < children.size()) {
+        Node* child = children[cursor.position++];
+
+        if (child->name.compare(0, cursor.prefix.size(), cursor.prefix) == 0) {
+            batch[count++] = child;
+        }
     }
-   
+
+    return count;
 }
 
 // creates a folder under the current folder
 void VFS::mkdir(string folder_name) {
+    checkOwner();
+
     // creates folder if folder name is valid
     if (isValid(folder_name, folder)) {
         // checks if folder name is unique
         if (isUnique(folder_name, curr_Node)) {
-            // creates a folder node
-            Node* newFolder = new Node(folder_name, curr_Node, folder, 10, getTime());
-
-            // adds to the children of current node
-            curr_Node->children.push_back(newFolder);
-
-            // updates size of the current folder
-            updateSize(newFolder);
+            // creates a folder node and adds it to the current folder
+            checkGrowth(curr_Node, 10, 1);
+            addNode(curr_Node, new Node(folder_name, curr_Node, folder, 10, timestampNow()));
         }
         else {
             throw runtime_error("Folder name is not unique");
@@ -147,19 +251,18 @@ void VFS::mkdir(string folder_name) {
 }
 
 // creates a file under the current folder with specified filename and size
-void VFS::touch(string file_name, unsigned int size) {
+void VFS::touch(string file_name, uint64_t size) {
+    checkOwner();
+
     // checks if the filename is valid
     if (isValid(file_name, file)) {
         // checks if the file name is unique
         if (isUnique(file_name, curr_Node)) {
-            // creates a file node
-            Node* newFile = new Node(file_name, curr_Node, file, size, getTime());
-
-            // adds to the children of current node
-            curr_Node->children.push_back(newFile);
-
-            // updates size of the current folder
-            updateSize(newFile);
+            // creates a file node holding a hole of size bytes
+            if (size > MAX_FILE_BYTES) {
+                throw runtime_error("File is too large");
+            }
+            addFile(curr_Node, file_name, size);
         }
         else {
             throw runtime_error("File name is not unique");
@@ -202,8 +305,8 @@ void VFS::cd(string path) {
         }
         // checks for folder name argument
         else {
-            // gets node of the specified name
-            Node* nextCurr = getChild(curr_Node, path);
+            // gets node of the specified name, following a symbolic link
+            Node* nextCurr = resolve(path);
 
             // checks if the specified node exists in the folder
             if (nextCurr == nullptr) {
@@ -211,7 +314,7 @@ void VFS::cd(string path) {
             }
 
             // checks if the specified node is not a file
-            if (nextCurr->type == file) {
+            if (nextCurr->inode->type != folder) {
                 throw runtime_error("Cannot change directory to a file");
             }
 
@@ -230,7 +333,7 @@ void VFS::cd(string path) {
         }
 
         // checks if path points to a file
-        if (tracking_ptr->type == file) {
+        if (tracking_ptr->inode->type != folder) {
             throw runtime_error("Cannot change directory to a file");
         }
 
@@ -242,6 +345,8 @@ void VFS::cd(string path) {
 
 // removes the specified folder or file
 void VFS::rm(string file_name) {
+    checkOwner();
+
     // variable that holds node to be removed
     Node* removeNode = getChild(curr_Node, file_name);
 
@@ -250,478 +355,3824 @@ void VFS::rm(string file_name) {
         throw runtime_error("File or folder does not exist");
     }
 
+    // stops copies from sharing the folder being changed, or the node leaving it
+    prepareMutation(curr_Node);
+    releaseNode(removeNode);
+
     // move to bin if found
     bin.enqueue(removeNode);
+    logUndo(undo_remove, removeNode, "");
 
     // keep track of path to item removed
     bin_paths.enqueue(getPath(removeNode));
 
     // remove node from children of current node
-    for (int i = 0; i < curr_Node->children.size(); i++) {
-        if (curr_Node->children[i] == removeNode) {
-            curr_Node->children.erase(i);
-            break;
-        }
-    }
+    detachChild(removeNode);
+    curr_Node->inode->time_modified = timestampNow();
+    notify(curr_Node, removeNode->name, removeNode->inode->type, watch_removed, 0);
+
+    // files in the bin leave the size index
+    indexSubtree(removeNode, false);
 
-    // update size of folder
-    updateSize(curr_Node);
+    // update size and counters of folder and its parents
+    chargeStats(curr_Node, nullptr, removeNode, false);
+    chargeLinks(curr_Node, nullptr, removeNode, false);
 }
 
 // returns the total size of the folder or file
-void VFS::size(string path) {
-    // checks if the path specified is a file or folder
-    size_t found = path.find('/');
-    // if the path does not contain '/', then it is either a file or folder
-    if(found == string::npos) {
-        // gets node of the specified name
-        Node* tracking_ptr = getChild(curr_Node, path);
+uint64_t VFS::size(string path) {
+    // the size includes the queued changes of a transaction
+    settleStats();
 
-        // checks if the specified node exists in the folder
-        if (tracking_ptr == nullptr) {
-            throw runtime_error("Specified file or folder does not exist");
-        }
+    // gets node at the given path
+    Node* ptr = (path == root->name) ? root : resolve(path);
 
-        // prints size 
-        cout << tracking_ptr->size << endl;
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
     }
-    else {
-        // checks if the path is the root
-        if (path == root->name) {
-            cout << root->size << endl;
-        }
-        else {
-            // gets node at the given path
-            Node* tracking_ptr = getNode(path);
-
-            // check if a valid node was returned
-            if (tracking_ptr == nullptr) {
-                throw runtime_error("Invalid path");
-            }
 
-            // prints size 
-            cout << tracking_ptr->size << endl;
-        }
-    }
+    return ptr->inode->size;
 }
 
-// shows the oldest node of the bin
-void VFS::showbin() {
-    // checks if bin is empty
-    if (bin.isEmpty()) {
-        throw runtime_error("Bin is empty");
-    }
+// returns the bytes of pages held by the files under a folder, or by a file
+// -- a page shared by several files, through deduplication or copies, is counted once
+uint64_t VFS::physicalSize(string path) {
+    // gets node at the given path
+    Node* ptr = (path == root->name) ? root : resolve(path);
 
-    // checks the type of the child
-    if (bin.front_element()->type == folder) {
-        cout << setw(4) << "dir" << " ";
-    }
-    else {
-        cout << setw(4) << "file" << " ";
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
     }
 
-    cout << setw(10) << bin.front_element()->name 
-        << " " << setw(5) << bin.front_element()->size
-        << " " << setw(15) << bin_paths.front_element()
-        << " " << setw(15) << bin.front_element()->time_created;
+    Vector<const ExtentRun*> runs;
+    collectRuns(ptr, runs);
+    return distinctBytes(runs);
 }
 
-// empties the bin
-void VFS::emptybin() {
-    while (!bin.isEmpty()) {
-        removeNode(bin.dequeue());
-        bin_paths.dequeue();
-    }
-}
+// returns a folder or file, and with -d N the folders up to N levels below it, subfolders first
+// -- params: [-d N] [path]
+Vector<PathEntry> VFS::du(string params) {
+    // variables for the options
+    int depth = 0;
+    string path;
 
-// returns the path of the file or folder if it exits
-void VFS::find(string name) {
-    // variable for holding matching nodes
-    Queue<Node*> matching_nodes;
+    // parses the options
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        if (token == "-d") {
+            if (!(sstr >> depth) || depth < 0) {
+                throw runtime_error("Invalid parameter");
+            }
+        }
+        else {
+            path = token;
+        }
+    }
 
-    // populates matching_nodes with all matching nodes
-    getMatchingNode(root, name, matching_nodes);
+    // gets node at the given path, the current folder by default
+    Node* ptr = resolve(path);
 
-    // enqueues path of matching nodes to path queue
-    while (!matching_nodes.isEmpty()) {
-        cout << getPath(matching_nodes.dequeue()) << endl;
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
     }
-}
 
-// moves a file located under the current node to the specified path
-void VFS::mv(string file, string folder) {
+    // the counters include the queued changes of a transaction
+    settleStats();
 
-    // gets node of file and folder
-    Node* file_node = (file.find('/') != string::npos) ? getNode(file) : getChild(curr_Node, file);
-    Node* folder_node = (folder.find('/') != string::npos) ? getNode(folder) : getChild(curr_Node, folder);
+    // collects every reported folder
+    Vector<PathEntry> entries;
+    duEntries(ptr, (ptr == root) ? root->name : getPath(ptr), depth, entries);
+    return entries;
+}
 
-    // checks if file and folder exist
-    if ((file_node == nullptr) || (folder_node == nullptr)) {
-        throw runtime_error("File or folder not located at specified path");
+// returns the k largest files under a folder, the current folder by default, largest first
+// -- params: <k> [path]
+Vector<PathEntry> VFS::top(string params) {
+    // variables for the options
+    int k;
+    string path;
+
+    // parses the options
+    stringstream sstr(params);
+    if (!(sstr >> k) || k <= 0) {
+        throw runtime_error("Invalid parameter");
     }
+    sstr >> path;
 
-    // checks if folder is actually of type folder
-    if (folder_node->type != NodeType::folder) {
-        throw runtime_error("Cannot change the directory to a file");
+    // gets node at the given path, the current folder by default
+    Node* ptr = resolve(path);
+
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
     }
 
-    // adds file at folder
-    folder_node->children.push_back(file_node);
+    // the largest files of each folder include the queued changes of a transaction
+    settleStats();
 
-    // remove file_node from children of its parent node
-    for (int i = 0; i < file_node->parent->children.size(); i++) {
-        if (file_node->parent->children[i] == file_node) {
-            file_node->parent->children.erase(i);
-            break;
+    // variable for the files found
+    Vector<PathEntry> entries;
+
+    // the whole tree is read straight from the size index, largest first
+    // -- files of copy-on-write clones are only indexed once expanded
+    if (ptr == root && cow_pending.empty()) {
+        for (SkipList<uint64_t, Node*>::Entry* entry = size_index.last(); entry != nullptr && entries.size() < k; entry = entry->prev) {
+            PathEntry found = {entry->value, getPath(entry->value)};
+            entries.push_back(found);
         }
     }
-
-    // updates size of the folder
-    if (file_node->parent == folder_node->parent) {
-        updateSize(folder_node);
-    } 
     else {
-        updateSize(folder_node);
-        updateSize(file_node->parent);
+        topEntries(ptr, k, entries);
     }
 
-    // update parent of file_node
-    file_node->parent = folder_node;
+    return entries;
 }
 
-//  reinstates the oldest node back from the bin to its original position
-void VFS::recover() {
-    // gets node to be recovered
-    Node* recoverNode = bin.dequeue();
-
-    // gets the path of the parent of the oldest node
-    string path = getPath(recoverNode->parent);
+// ---------------- QUERIES -------------------------
+// sizes and creation times are kept in ordered indexes, so a range of either is read in O(log n + k)
+// for its k nodes; with both, the range holding fewer nodes is read and the other one is checked on
+// each node. Clones not yet expanded are not in the indexes, so what they share is walked instead
 
-    // gets the node at the parent
-    // -- if the node returned is not nullptr then the parent still exists
-    Node* parentNode = getNode(path);
+// reads a query value into the range of values it stands for
+// -- a size takes a K, M, G or T suffix; a time is seconds since the epoch, standing for the whole
+//    second, or an age such as -30m, -1h or -2d counted back from now
+static void parseQueryValue(const string &text, bool is_time, uint64_t &start, uint64_t &end) {
+    // an age is counted back from now
+    bool age = is_time && !text.empty() && text[0] == '-';
+    size_t pos = age ? 1 : 0;
 
-    // checks if the node returned is not nullptr
-    if (parentNode == nullptr) {
-        throw runtime_error("Path to node doesn't exist anymore");
+    if (pos == text.size() || !isdigit((unsigned char)text[pos])) {
+        throw runtime_error("Invalid parameter");
     }
 
-    // adds the node back to its parent
-    parentNode->children.push_back(recoverNode);
+    // reads the digits, refusing values past 64 bits
+    uint64_t value = 0;
+    for (; pos < text.size() && isdigit((unsigned char)text[pos]); pos++) {
+        uint64_t digit = text[pos] - '0';
+        if (value > (UINT64_MAX - digit) / 10) {
+            throw runtime_error("Invalid parameter");
+        }
+        value = value * 10 + digit;
+    }
 
-}
+    // reads the unit, seconds for times
+    string suffix = text.substr(pos);
+    uint64_t unit = 0;
+    if (!is_time) {
+        if (suffix.empty()) unit = 1;
+        else if (suffix == "K") unit = 1ULL << 10;
+        else if (suffix == "M") unit = 1ULL << 20;
+        else if (suffix == "G") unit = 1ULL << 30;
+        else if (suffix == "T") unit = 1ULL << 40;
+    }
+    else if (suffix.empty() || (age && suffix == "s")) unit = 1000000000ULL;
+    else if (age && suffix == "m") unit = 60 * 1000000000ULL;
+    else if (age && suffix == "h") unit = 3600 * 1000000000ULL;
+    else if (age && suffix == "d") unit = 86400 * 1000000000ULL;
 
-// exits the program
-void VFS::exit() {
-    // creates output stream
-    ofstream output("vfs.dat", ios::out);
+    if (unit == 0 || value > UINT64_MAX / unit) {
+        throw runtime_error("Invalid parameter");
+    }
+    value *= unit;
 
-    // checks if file opened successfully
-    if (output) {
-        // writes data to output file
-        write(output, root);
+    if (age) {
+        uint64_t now = timestampNow();
+        start = end = (value < now) ? now - value : 0;
+    }
+    else if (is_time) {
+        start = value;
+        end = (value > UINT64_MAX - (unit - 1)) ? UINT64_MAX : value + (unit - 1);
     }
     else {
-        throw runtime_error("File failed to open");
+        start = end = value;
     }
-
-    // close file
-    output.close();
-}
-
-
-// ---------------- HELPER METHODS -------------------------
-
-// returns system time as a string
-string VFS::getTime() {
-    // creates a variable of hold current time  of type time_t
-    time_t timer;
-
-    // gets current time
-    time(&timer);
-
-    // converts time_t value to string
-    return ctime(&timer);
 }
 
-// returns the path of the current node
-string VFS::getPath(Node *ptr) {
-    // checks if the current node is the root
-    if (ptr->name ==  root->name) {
-        return "";
+// narrows an inclusive range by one comparison with a value standing for [start, end]
+// -- a range that can hold nothing is left with low above high
+static void narrowRange(const string &op, uint64_t start, uint64_t end, uint64_t &low, uint64_t &high) {
+    if (op == ">") {
+        if (end == UINT64_MAX) {
+            low = 1;
+            high = 0;
+        }
+        else {
+            low = max(low, end + 1);
+        }
+    }
+    else if (op == ">=") {
+        low = max(low, start);
+    }
+    else if (op == "<") {
+        if (start == 0) {
+            low = 1;
+            high = 0;
+        }
+        else {
+            high = min(high, start - 1);
+        }
+    }
+    else if (op == "<=") {
+        high = min(high, end);
     }
     else {
-        return getPath(ptr->parent) + '/' + ptr->name;
+        low = max(low, start);
+        high = min(high, end);
     }
 }
 
-// checks if file or folder name is valid
-bool VFS::isValid(string name, NodeType type) {
-    // folder check
-    if (type == folder) {
-        // checks for every character in folder name
-        for (int i = 0; i < name.size(); i++) {
-            if ((int(name[i]) >= int('A') &&  int(name[i]) <= int('Z')) || 
-                (int(name[i]) >= int('a') && int(name[i]) <= int('z')) || 
-                (int(name[i]) >= int('0') && int(name[i]) <= int('9'))) {}
-            else {
-                return false;
+// returns the nodes below a folder, the current folder by default, matching every predicate
+// -- params: [size<op>N] [ctime<op>T] [name=glob] [type=f|d] [-n limit] [path], <op> one of < <= = >= >
+// -- nodes found through an index come in the order of that index, smallest first
+Vector<PathEntry> VFS::query(string params) {
+    // variables for the predicates
+    QueryFilter filter = {false, 0, UINT64_MAX, false, 0, UINT64_MAX, "", -1, -1};
+    string path;
+
+    // parses the predicates
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        size_t op_pos = token.find_first_of("<>=");
+
+        if (token == "-n") {
+            if (!(sstr >> filter.limit) || filter.limit <= 0) {
+                throw runtime_error("Invalid parameter");
             }
         }
-        return true;
-    }
-    else {
-        // checks for every character in file name
-        for (int i = 0; i < name.size(); i++) {
-            if ((int(name[i]) >= int('A') &&  int(name[i]) <= int('Z')) || 
-                (int(name[i]) >= int('a') && int(name[i]) <= int('z')) || 
-                (int(name[i]) >= int('0') && int(name[i]) <= int('9')) ||
-                (int(name[i]) == int('.'))) {}
+        else if (op_pos == string::npos) {
+            path = token;
+        }
+        else {
+            // splits field, comparison and value
+            size_t value_pos = token.find_first_not_of("<>=", op_pos);
+            string field = token.substr(0, op_pos);
+            string op = token.substr(op_pos, (value_pos == string::npos) ? string::npos : value_pos - op_pos);
+            string value = (value_pos == string::npos) ? "" : token.substr(value_pos);
+
+            if (op != "<" && op != "<=" && op != "=" && op != ">=" && op != ">") {
+                throw runtime_error("Invalid parameter");
+            }
+
+            if (field == "size" || field == "ctime") {
+                uint64_t start, end;
+                parseQueryValue(value, field == "ctime", start, end);
+
+                if (field == "size") {
+                    filter.by_size = true;
+                    narrowRange(op, start, end, filter.size_min, filter.size_max);
+                }
+                else {
+                    filter.by_time = true;
+                    narrowRange(op, start, end, filter.time_min, filter.time_max);
+                }
+            }
+            else if (field == "name" && op == "=" && !value.empty()) {
+                filter.name = value;
+            }
+            else if (field == "type" && op == "=" && (value == "f" || value == "d")) {
+                filter.type = (value == "f") ? file : folder;
+            }
             else {
-                return false;
+                throw runtime_error("Invalid parameter");
             }
         }
-        return true;
     }
-}
 
-// checks if file or folder name is unique
-bool VFS::isUnique(string name, Node* curr_dir) {
-    // checks the file or folder name is unique
-    for (int i = 0; i < curr_dir->children.size(); i++) {
-        if (curr_dir->children[i]->name == name) {
-            return false;
-        }
+    // gets node at the given path, the current folder by default
+    Node* ptr = resolve(path);
+
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
     }
 
-    return true;
-}
+    // variable for the nodes found
+    Vector<PathEntry> entries;
 
-// returns a specific child of given Node
-Node* VFS::getChild(Node *ptr, string childname) {
-    for (int i = 0; i < ptr->children.size(); i++) {
-        if (ptr->children[i]->name == childname) {
-            return ptr->children[i];
-        }
+    // a range left empty by its comparisons matches nothing
+    if (filter.size_min > filter.size_max || filter.time_min > filter.time_max) {
+        return entries;
     }
-    return nullptr;
-}	
 
-// populates a queue with matching nodes
-void VFS::getMatchingNode(Node *ptr, string name, Queue<Node*>& matching_nodes) {
-    for (int i = 0; i < ptr->children.size(); i++) {
-        if (ptr->children[i]->name == name) {
-            matching_nodes.enqueue(ptr->children[i]);
-        }
-        getMatchingNode(ptr->children[i], name, matching_nodes);
+    // without a range, only a walk can find the nodes
+    if (!filter.by_size && !filter.by_time) {
+        queryWalk(ptr, getPath(ptr), filter, entries);
+        return entries;
     }
-}
 
-//Helper method to get a pointer to Node at given path
-Node* VFS::getNode(string path) {
-    // converts path to stringstream
-    stringstream sstr(path);
-
-    // variable for keeping track subdirectories
-    string current_child;
+    // clones below the folder that are not expanded yet share nodes the indexes do not hold
+    Vector<Node*> clones;
+    for (SkipList<uint64_t, Node*>::Entry* entry = cow_pending.first(); entry != nullptr; entry = entry->next[0]) {
+        if (isUnder(entry->value, ptr) && isAttached(entry->value)) {
+            clones.push_back(entry->value);
+        }
+    }
 
-    // reads first current folder from the path
-    getline(sstr, current_child, '/');
+    // both ranges are read a step at a time until one of them ends, which picks the smaller one
+    // without reading more of the larger one than the smaller holds
+    SkipList<uint64_t, Node*>::Entry* size_entry = filter.by_size ? size_index.lowerBound(filter.size_min) : nullptr;
+    SkipList<uint64_t, Node*>::Entry* time_entry = filter.by_time ? time_index.lowerBound(filter.time_min) : nullptr;
+    bool use_size = !filter.by_time;
 
-    // variable for keeping track of subdirectories
-    Node* tracking_ptr = path[0] == '/' ? root : curr_Node;
+    if (filter.by_size && filter.by_time) {
+        SkipList<uint64_t, Node*>::Entry* by_size = size_entry;
+        SkipList<uint64_t, Node*>::Entry* by_time = time_entry;
 
-    // loops through path to get to specific node
-    while (!sstr.eof()) {
-        getline(sstr, current_child, '/');
-        tracking_ptr = getChild(tracking_ptr, current_child);
+        while (true) {
+            if (by_size == nullptr || by_size->key > filter.size_max) {
+                use_size = true;
+                break;
+            }
+            if (by_time == nullptr || by_time->key > filter.time_max) {
+                use_size = false;
+                break;
+            }
+            by_size = by_size->next[0];
+            by_time = by_time->next[0];
+        }
     }
 
-    return tracking_ptr;
-}
+    // reads the chosen range, checking the other predicates on every node
+    // -- the index holds the whole tree, so nodes outside the folder are skipped; once the read
+    //    skipped as many nodes as the folder holds, walking the folder is cheaper, so a query costs
+    //    O(log n + min(r, s) * depth) for r nodes in the range and s nodes under the folder
+    SkipList<uint64_t, Node*>::Entry* entry = use_size ? size_entry : time_entry;
+    uint64_t high = use_size ? filter.size_max : filter.time_max;
 
-// re-calculates the size of an Node and its parents
-void VFS::updateSize(Node *ptr) {
-    // checks if ptr is a folder and updates its size
-    if (ptr->type == folder) {
+    settleStats();
+    uint64_t budget = (ptr == root) ? UINT64_MAX : uint64_t(ptr->inode->stats.files) + ptr->inode->stats.folders;
+    uint64_t read = 0;
 
-        if (ptr == root) {
-            // set the size to the default size
-            ptr->size = 0;
+    for (; entry != nullptr && entry->key <= high; entry = entry->next[0]) {
+        // the limit can only end the read early when no clone adds nodes afterwards
+        if (clones.empty() && filter.limit > 0 && entries.size() >= filter.limit) {
+            break;
         }
-        else {
-            // set the size to the default size
-            ptr->size = 10;
+
+        // the folder is walked instead, clones included, and ordered like the range below
+        if (++read > budget) {
+            entries.clear();
+            clones.clear();
+            clones.push_back(ptr);
+            break;
         }
 
-        // adds the size of children
-        for (int i = 0; i < ptr->children.size(); i++) {
-            ptr->size += ptr->children[i]->size;
+        Node* node = entry->value;
+        if (node != ptr && (ptr == root || isUnder(node, ptr)) && matchesQuery(node, filter)) {
+            PathEntry found = {node, getPath(node)};
+            entries.push_back(found);
         }
     }
 
-    while (ptr->parent != nullptr) {
-        // set the size of the parent to the default size if not root
-        if (ptr->parent != root) {
-            ptr->parent->size = 10;
-        }
-        else {
-            ptr->parent->size = 0;
-        }
+    if (clones.empty()) {
+        return entries;
+    }
 
-        // adds the size of children
-        for (int i = 0; i < ptr->parent->children.size(); i++) {
-            ptr->parent->size += ptr->parent->children[i]->size;
-        }
+    // walks what each clone shares, or the whole folder, then orders every node found as the index would
+    QueryFilter unlimited = filter;
+    unlimited.limit = -1;
+    for (int i = 0; i < clones.size(); i++) {
+        queryWalk(clones[i], getPath(clones[i]), unlimited, entries);
+    }
 
-        // updates current ptr
-        ptr = ptr->parent;
+    if (entries.size() > 1) {
+        stable_sort(&entries[0], &entries[0] + entries.size(), [use_size](const PathEntry &a, const PathEntry &b) {
+            return use_size ? a.node->inode->size < b.node->inode->size : a.node->inode->time_created < b.node->inode->time_created;
+        });
     }
-}	
 
-// sorts a vector of node pointers
-void VFS::bubbleSort(Vector<Node*>& container) {
-    for (int i = 0; i < container.size(); i++) {
-        for (int j = 0; j < container.size() - i - 1; j++) {
-            if (container[j]->size < container[j+1]->size) {
-                Node* temp = container[j];
-                container[j] = container[j+1];
-                container[j+1] = temp;
-            }
+    // keeps the first nodes up to the limit
+    if (filter.limit > 0 && entries.size() > filter.limit) {
+        Vector<PathEntry> first;
+        for (int i = 0; i < filter.limit; i++) {
+            first.push_back(entries[i]);
         }
+        return first;
     }
+
+    return entries;
 }
 
-// traverse and write recursively the vfs data
-void VFS::write(ofstream &fout, Node *ptr) {
-    // writes data corresponding to ptr to output stream
-    if (ptr == root) {
-        fout << "/";
-    }
+// ---------------- QUOTAS -------------------------
+// a folder may limit the bytes and the files and folders under it. Every change that adds to a
+// folder checks the totals the folders keep against the quotas above it; each node caches the
+// nearest tagged folder above it, one with a quota or a watch, so a check only visits the folders
+// that have one. The cache holds while the tag epoch is unchanged, which moves, recovers, rollbacks,
+// new quotas and new watches bump. Every check also keeps the totals of the tree from overflowing
+
+// sets the limits of a folder, the current folder by default, and returns the folders whose quotas
+// apply to it, nearest first
+// -- params: [-b bytes] [-n nodes] [path]; bytes take a K, M, G or T suffix and 0 drops a limit
+Vector<PathEntry> VFS::quota(string params) {
+    // variables for the options, -1 where a limit is not given
+    int64_t bytes = -1;
+    int64_t nodes = -1;
+    string path;
+
+    // parses the options
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        if (token == "-b" || token == "-n") {
+            string value;
+            uint64_t start, end;
+            if (!(sstr >> value)) {
+                throw runtime_error("Invalid parameter");
+            }
+            parseQueryValue(value, false, start, end);
+
+            if (start > INT64_MAX) {
+                throw runtime_error("Invalid parameter");
+            }
+            (token == "-b" ? bytes : nodes) = start;
+        }
+        else {
+            path = token;
+        }
+    }
+
+    // gets node at the given path, the current folder by default
+    Node* ptr = resolve(path);
+
+    // checks if a folder was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
+    }
+    if (ptr->inode->type != folder) {
+        throw runtime_error("Quotas are set on folders");
+    }
+
+    // sets the limits given, keeping the other one
+    // -- a quota below what the folder holds stops it from growing
+    if (bytes >= 0 || nodes >= 0) {
+        checkOwner();
+
+        Quota limits = {0, 0};
+        if (ptr->inode->quota != nullptr) {
+            limits = *ptr->inode->quota;
+        }
+        if (bytes >= 0) {
+            limits.bytes = bytes;
+        }
+        if (nodes >= 0) {
+            limits.nodes = nodes;
+        }
+
+        // a folder without limits drops its quota
+        logUndo(undo_quota, ptr, "");
+        delete ptr->inode->quota;
+        ptr->inode->quota = (limits.bytes == 0 && limits.nodes == 0) ? nullptr : new Quota(limits);
+        tag_epoch++;
+    }
+
+    // the totals include the queued changes of a transaction
+    settleStats();
+
+    // collects the folders with a quota from the folder up
+    Vector<PathEntry> entries;
+    for (Node* curr = getTaggedFolder(ptr); curr != nullptr; curr = getTaggedFolder(curr->parent)) {
+        if (curr->inode->quota != nullptr) {
+            PathEntry found = {curr, getPath(curr)};
+            entries.push_back(found);
+        }
+    }
+    return entries;
+}
+
+// ---------------- WATCHES -------------------------
+// a watch hears of the nodes created, removed, written, moved, recovered and purged in a folder, or
+// anywhere below it when recursive. A watched folder is tagged like a quota folder, so a mutation
+// finds the watches above it through the cached tagged folders instead of comparing paths, and pays
+// a single test while nothing is watched. Events of a transaction are held back until commit
+
+// watches the folder at path, the current folder by default, and returns the id of the watch
+// -- params: [-r] [path]; with -r the changes anywhere below the folder are seen
+int VFS::watch(string params) {
+    // variables for the options
+    bool recursive = false;
+    string path;
+
+    // parses the options
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        if (token == "-r") {
+            recursive = true;
+        }
+        else {
+            path = token;
+        }
+    }
+
+    // gets node at the given path, the current folder by default
+    Node* ptr = resolve(path);
+
+    // checks if a folder was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
+    }
+    if (ptr->inode->type != folder) {
+        throw runtime_error("Watches are set on folders");
+    }
+
+    // adds the watch to the folder, which tags it for the nodes below
+    Watch* added = new Watch;
+    added->id = next_watch++;
+    added->recursive = recursive;
+    added->session = session_id;
+    watches.push_back(added);
+    attachWatch(added, ptr);
+    tag_epoch++;
+
+    return added->id;
+}
+
+// drops a watch with the events it still holds
+void VFS::unwatch(int id) {
+    int index = findWatch(id);
+    if (index < 0) {
+        throw runtime_error("Watch does not exist");
+    }
+    Watch* dropped = watches[index];
+
+    // removes the watch from its folder, which stays tagged while it has another
+    if (dropped->folder != nullptr) {
+        detachWatch(dropped);
+        tag_epoch++;
+    }
+
+    // events of the open transaction for it are dropped with it
+    if (!staged.empty()) {
+        Vector<StagedEvent> kept;
+        for (int i = 0; i < staged.size(); i++) {
+            if (staged[i].watch != dropped) {
+                kept.push_back(staged[i]);
+            }
+        }
+        staged = kept;
+    }
+
+    watches.erase(index);
+    delete dropped;
+}
+
+// drops every watch a session set, once the session ends
+void VFS::unwatchSession(int id) {
+    for (int i = watches.size() - 1; i >= 0; i--) {
+        if (watches[i]->session == id) {
+            unwatch(watches[i]->id);
+        }
+    }
+}
+
+// returns the events of a watch, which another thread may take while the tree changes
+// -- the ring stays valid until the watch is dropped
+WatchRing* VFS::watchRing(int id) {
+    int index = findWatch(id);
+    if (index < 0) {
+        throw runtime_error("Watch does not exist");
+    }
+
+    return &watches[index]->ring;
+}
+
+// returns the oldest node of the bin and the path it was removed from
+PathEntry VFS::showbin() {
+    // checks if bin is empty
+    if (bin.isEmpty()) {
+        throw runtime_error("Bin is empty");
+    }
+
+    // the size includes the queued changes of a transaction
+    settleStats();
+
+    PathEntry oldest = {bin.front_element(), bin_paths.front_element()};
+    return oldest;
+}
+
+// empties the bin
+void VFS::emptybin() {
+    // nodes on the stack of an open walk must stay alive
+    if (open_walks > 0) {
+        throw runtime_error("Cannot empty the bin while a walk is in progress");
+    }
+
+    // an abort may still put the nodes back
+    if (in_transaction) {
+        throw runtime_error("Cannot empty the bin during a transaction");
+    }
+
+    // the watches hear of every node before any is deleted, while the folders the nodes were
+    // removed from are all still there
+    Vector<Node*> purged;
+    while (!bin.isEmpty()) {
+        Node* ptr = bin.dequeue();
+        bin_paths.dequeue();
+        notify(ptr->parent, ptr->name, ptr->inode->type, watch_purged, 0);
+        leaveNode(ptr);
+        purged.push_back(ptr);
+    }
+
+    // a node removed from a folder that was removed after it still points at that folder, so every
+    // node leaves its old folder before any is deleted
+    for (int i = 0; i < purged.size(); i++) {
+        purged[i]->parent = nullptr;
+    }
+
+    for (int i = 0; i < purged.size(); i++) {
+        removeNode(purged[i]);
+    }
+}
+
+// returns every file or folder with the given name and its path
+Vector<PathEntry> VFS::find(string name) {
+    // variable for holding matching nodes
+    Vector<PathEntry> matching_nodes;
+
+    // populates matching_nodes with all matching nodes
+    getMatchingNode(root, "", name, matching_nodes);
+
+    return matching_nodes;
+}
+
+// moves a file or folder into the specified folder, or renames it if the path does not exist
+void VFS::mv(string file, string folder) {
+    checkOwner();
+
+    // gets node of file and folder
+    // -- a symbolic link is moved itself, but leads on as the destination
+    Node* file_node = file.empty() ? nullptr : resolve(file, false);
+    Node* folder_node = folder.empty() ? nullptr : resolve(folder);
+
+    // checks if file exists
+    if (file_node == nullptr) {
+        throw runtime_error("File or folder not located at specified path");
+    }
+
+    // checks if file is the root
+    if (file_node == root) {
+        throw runtime_error("Cannot move the root folder");
+    }
+
+    // variable for the name of the node after the move
+    string new_name = file_node->name;
+
+    // renames the node if the destination does not exist
+    if (folder_node == nullptr) {
+        folder_node = getParentFolder(folder, new_name);
+
+        // checks if the new name is valid
+        if (!isValid(new_name, file_node->inode->type)) {
+            throw runtime_error("New name is not valid");
+        }
+    }
+    // checks if folder is actually of type folder
+    else if (folder_node->inode->type != NodeType::folder) {
+        throw runtime_error("Cannot change the directory to a file");
+    }
+
+    // checks if the folder is the node itself or one of its descendants
+    for (Node* curr = folder_node; curr != nullptr; curr = curr->parent) {
+        if (curr == file_node) {
+            throw runtime_error("Cannot move a folder into itself");
+        }
+    }
+
+    // nothing to do if the node stays where it is
+    if (folder_node == file_node->parent && new_name == file_node->name) {
+        return;
+    }
+
+    // checks if the name is free at the destination
+    if (!isUnique(new_name, folder_node)) {
+        throw runtime_error("File or folder name is not unique at the destination");
+    }
+
+    // keeps the old parent for the size update
+    Node* old_parent = file_node->parent;
+
+    // the folders gaining the node are those below the common ancestor, whose totals do not change
+    Node* common = (old_parent != folder_node) ? getCommonAncestor(old_parent, folder_node) : old_parent;
+    if (old_parent != folder_node) {
+        Vector<QuotaCharge> charges;
+        chargeQuotas(charges, folder_node, getTaggedFolder(common), file_node->inode->size,
+                     file_node->inode->stats.files + file_node->inode->stats.folders);
+        discountLinks(charges, file_node);
+        checkCharges(charges);
+    }
+
+    // stops copies from sharing either folder being changed, or the node moving between them
+    prepareMutation(folder_node);
+    prepareMutation(old_parent);
+    releaseNode(file_node);
+
+    // remove file_node from children of its parent node
+    logUndo(undo_move, file_node, "");
+    detachChild(file_node);
+
+    // both events of the move carry the same cookie, never 0
+    next_cookie = (next_cookie == UINT32_MAX) ? 1 : next_cookie + 1;
+    notify(old_parent, file_node->name, file_node->inode->type, watch_moved_from, next_cookie);
+
+    // adds file at folder under its new name
+    file_node->name = new_name;
+    attachChild(folder_node, file_node);
+    old_parent->inode->time_modified = folder_node->inode->time_modified = timestampNow();
+    notify(folder_node, new_name, file_node->inode->type, watch_moved_to, next_cookie);
+
+    // updates sizes and counters of both parent chains up to their common ancestor
+    // -- the folders above the node changed, so the tagged folders cached below it are found again
+    // -- the gain goes first, so a folder that keeps the largest file through the move is not recounted
+    if (old_parent != folder_node) {
+        tag_epoch++;
+        chargeStats(folder_node, common, file_node, true);
+        chargeStats(old_parent, common, file_node, false);
+        chargeLinks(folder_node, common, file_node, true);
+        chargeLinks(old_parent, common, file_node, false);
+    }
+}
+
+// copies a file, or a folder with recursive set, to the specified path
+// -- with cow set the copy shares the source's children until either side changes
+void VFS::cp(string src, string dst, bool recursive, bool cow) {
+    checkOwner();
+
+    // gets node to be copied
+    // -- a recursive copy copies a symbolic link itself, a plain one copies what it leads to
+    Node* src_node = src.empty() ? nullptr : resolve(src, !recursive);
+
+    // checks if the source exists
+    if (src_node == nullptr) {
+        throw runtime_error("File or folder not located at specified path");
+    }
+
+    // checks if the source is the root
+    if (src_node == root) {
+        throw runtime_error("Cannot copy the root folder");
+    }
+
+    // checks if a folder is copied without the recursive flag
+    if (src_node->inode->type == folder && !recursive) {
+        throw runtime_error("Cannot copy a folder without -r");
+    }
+
+    // gets node at the destination
+    Node* dst_node = dst.empty() ? nullptr : resolve(dst);
+
+    // variables for the folder receiving the copy and the name of the copy
+    Node* parent_node;
+    string copy_name;
+
+    // copies into an existing folder under the same name
+    if (dst_node != nullptr) {
+        if (dst_node->inode->type != folder) {
+            throw runtime_error("Destination already exists");
+        }
+
+        parent_node = dst_node;
+        copy_name = src_node->name;
+    }
+    // otherwise the last part of the destination names the copy
+    else {
+        parent_node = getParentFolder(dst, copy_name);
+    }
+
+    // checks if the name of the copy is valid and unique
+    if (!isValid(copy_name, src_node->inode->type)) {
+        throw runtime_error("Copy name is not valid");
+    }
+    if (!isUnique(copy_name, parent_node)) {
+        throw runtime_error("Copy name is not unique");
+    }
+
+    // the copy takes the counters of the source, queued changes included
+    // -- the copy gives each name of a hard-linked file its own inode, so it counts each name
+    settleStats();
+    checkGrowth(parent_node, src_node->inode->size + sharedBytes(src_node),
+                src_node->inode->stats.files + src_node->inode->stats.folders);
+
+    // copies the subtree before the destination changes
+    // -- so a copy into the source's own subtree does not contain itself
+    Node* copy = cloneNode(src_node, parent_node, cow);
+    copy->name = copy_name;
+
+    // stops copies from sharing the folder being changed
+    prepareMutation(parent_node);
+
+    // adds the copy to its folder
+    attachChild(parent_node, copy);
+    logUndo(undo_create, copy, "");
+    parent_node->inode->time_modified = timestampNow();
+    notify(parent_node, copy_name, copy->inode->type, watch_created, 0);
+
+    // adds the copied files to the size index
+    indexSubtree(copy, true);
+
+    // updates sizes and counters of the ancestors once for the whole subtree
+    chargeStats(parent_node, nullptr, copy, true);
+}
+
+// creates a hard link to the node at target, or with symbolic a link holding the path target, at link
+// -- a hard link is one more name of the same inode, so the names share content and size; a symbolic
+//    link is a node of its own whose content is the path, followed when a path through it is resolved
+void VFS::ln(string target, string link, bool symbolic) {
+    checkOwner();
+
+    if (target.empty() || link.empty()) {
+        throw runtime_error("Invalid parameter");
+    }
+
+    // variable for the node a hard link names
+    Node* src_node = nullptr;
+
+    if (symbolic) {
+        // the path is kept to the characters of names, so it is written into vfs.dat as it is
+        if (target.size() > SYMLINK_BYTES) {
+            throw runtime_error("Link target is too long");
+        }
+        for (int i = 0; i < target.size(); i++) {
+            if (!isalnum((unsigned char)target[i]) && target[i] != '.' && target[i] != '/') {
+                throw runtime_error("Link target is not valid");
+            }
+        }
+    }
+    else {
+        // a hard link names the node at target itself, even a symbolic link
+        src_node = resolve(target, false);
+
+        if (src_node == nullptr) {
+            throw runtime_error("File or folder not located at specified path");
+        }
+        if (src_node->inode->type == folder) {
+            throw runtime_error("Cannot hard link a folder");
+        }
+    }
+
+    // gets node at the destination
+    Node* dst_node = resolve(link);
+
+    // variables for the folder receiving the link and the name of the link
+    Node* parent_node;
+    string link_name;
+
+    // links into an existing folder under the last name of the target
+    if (dst_node != nullptr) {
+        if (dst_node->inode->type != folder) {
+            throw runtime_error("Destination already exists");
+        }
+
+        parent_node = dst_node;
+        link_name = target.substr(target.find_last_of('/') + 1);
+    }
+    // otherwise the last part of the destination names the link
+    else {
+        parent_node = getParentFolder(link, link_name);
+    }
+
+    // checks if the name of the link is valid and unique
+    if (link_name.empty() || !isValid(link_name, symbolic ? symbolic_link : file)) {
+        throw runtime_error("Link name is not valid");
+    }
+    if (!isUnique(link_name, parent_node)) {
+        throw runtime_error("Link name is not unique");
+    }
+
+    // a symbolic link adds its path to the sizes, a hard link one more file
+    // -- the bytes of a hard link only grow the folders not yet holding a name of the file
+    if (symbolic) {
+        checkGrowth(parent_node, target.size(), 0);
+    }
+    else {
+        Node* held = getLinkHolder(parent_node, src_node, nullptr);
+        Vector<QuotaCharge> charges;
+        chargeQuotas(charges, parent_node, getTaggedFolder(held), src_node->inode->size, 0);
+        chargeQuotas(charges, parent_node, nullptr, 0, 1);
+        addCharge(charges, root, (held == nullptr) ? src_node->inode->size : 0, 1);
+        checkCharges(charges);
+    }
+
+    if (symbolic) {
+        // the path is the content of the link and its length the size
+        Node* newLink = new Node(link_name, parent_node, symbolic_link, target.size(), timestampNow());
+        newLink->inode->data.write(0, target.data(), target.size(), false);
+        addNode(parent_node, newLink);
+        return;
+    }
+
+    // the inode lists its names once it has more than one
+    // -- the first link makes the file count as linked in the folders above it, which then count
+    //    its bytes once for all its names
+    Inode* inode = src_node->inode;
+    if (inode->stats.links == 0) {
+        prepareInode(src_node);
+        logUndo(undo_link, src_node, "");
+
+        Node linked("", nullptr, folder, 0, 0);
+        linked.inode->stats = Stats();
+        linked.inode->stats.links = 1;
+
+        inode->stats.links = 1;
+        chargeStats(src_node->parent, nullptr, &linked, true);
+    }
+
+    Node* newLink = new Node(link_name, parent_node, inode);
+
+    if (inode->names == nullptr) {
+        inode->names = new Vector<Node*>;
+        inode->names->push_back(src_node);
+    }
+    inode->names->push_back(newLink);
+
+    addNode(parent_node, newLink);
+}
+
+// returns the path held by the symbolic link at path
+string VFS::readlink(string path) {
+    Node* ptr = resolve(path, false);
+
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
+    }
+    if (ptr->inode->type != symbolic_link) {
+        throw runtime_error("Not a symbolic link");
+    }
+
+    return readLink(ptr);
+}
+
+//  reinstates the oldest node back from the bin to its original position
+void VFS::recover() {
+    checkOwner();
+
+    // checks if bin is empty
+    if (bin.isEmpty()) {
+        throw runtime_error("Bin is empty");
+    }
+
+    // gets node to be recovered
+    // -- it stays in the bin until it can be put back
+    Node* recoverNode = bin.front_element();
+
+    // gets the path of the parent of the oldest node
+    string path = getPath(recoverNode->parent);
+
+    // gets the node at the parent
+    // -- if the node returned is not nullptr then the parent still exists
+    Node* parentNode = path.empty() ? root : getNode(path);
+
+    // a node that cannot go back is moved to the end of the bin, so the nodes behind it can still be
+    // recovered; it is tried again once every other node was
+    if (parentNode == nullptr || parentNode->inode->type != folder) {
+        skipBin();
+        throw runtime_error("Path to node doesn't exist anymore");
+    }
+
+    // checks if the name was taken in the meantime
+    if (!isUnique(recoverNode->name, parentNode)) {
+        skipBin();
+        throw runtime_error("File or folder name is not unique anymore");
+    }
+
+    // the folder holding the path may be another one than the node left, with other quotas
+    // -- a folder already holding another name of a linked file under the node does not grow by it
+    Vector<QuotaCharge> charges;
+    uint64_t nodes = recoverNode->inode->stats.files + recoverNode->inode->stats.folders;
+    chargeQuotas(charges, parentNode, nullptr, recoverNode->inode->size, nodes);
+    addCharge(charges, root, recoverNode->inode->size, nodes);
+    discountLinks(charges, recoverNode);
+    checkCharges(charges);
+
+    // stops copies from sharing the folder being changed
+    prepareMutation(parentNode);
+
+    // removes the node and its path from the bin
+    logUndo(undo_recover, recoverNode, bin_paths.front_element());
+    bin.dequeue();
+    bin_paths.dequeue();
+
+    // adds the node back to its parent
+    attachChild(parentNode, recoverNode);
+    parentNode->inode->time_modified = timestampNow();
+    tag_epoch++;
+    notify(parentNode, recoverNode->name, recoverNode->inode->type, watch_recovered, 0);
+
+    // adds the recovered files back to the size index
+    indexSubtree(recoverNode, true);
+
+    // updates size and counters of the parent and its ancestors
+    chargeStats(parentNode, nullptr, recoverNode, true);
+    chargeLinks(parentNode, nullptr, recoverNode, true);
+}
+
+// moves the oldest node of the bin behind the newest one
+void VFS::skipBin() {
+    logUndo(undo_skip, bin.front_element(), "");
+    bin.enqueue(bin.dequeue());
+    bin_paths.enqueue(bin_paths.dequeue());
+}
+
+// exits the program
+// -- vfs.dat keeps the format of the last file loaded or saved
+void VFS::exit() {
+    save("vfs.dat", compressed_dat);
+}
+
+// writes the tree to a file, compressed or in the text format
+void VFS::save(string filename, bool compressed) {
+    // only committed changes are saved
+    if (in_transaction) {
+        throw runtime_error("Cannot save during a transaction");
+    }
+
+    // creates output stream
+    ofstream output(filename, compressed ? ios::out | ios::binary : ios::out);
+
+    // checks if file opened successfully
+    if (!output) {
+        throw runtime_error("File failed to open");
+    }
+
+    // writes data to output file
+    if (compressed) {
+        DatWriter writer;
+        writeRecords(writer, root, "/");
+        writer.finish(output);
+    }
+    else {
+        write(output, root);
+    }
+
+    compressed_dat = compressed;
+
+    // close file
+    output.close();
+}
+
+// returns the working folders as paths
+Session VFS::getSession() {
+    Session session = {getPath(curr_Node), getPath(prev_Node), session_id};
+    return session;
+}
+
+// switches to the working folders of a session
+// -- a folder that no longer exists falls back to the root
+void VFS::setSession(Session session) {
+    session_id = session.id;
+    curr_Node = session.curr.empty() ? root : getNode(session.curr);
+    prev_Node = session.prev.empty() ? root : getNode(session.prev);
+
+    if (curr_Node == nullptr || curr_Node->inode->type != folder) {
+        curr_Node = root;
+    }
+    if (prev_Node == nullptr || prev_Node->inode->type != folder) {
+        prev_Node = root;
+    }
+}
+
+// ---------------- TRANSACTIONS -------------------------
+// between begin and commit every mutation is logged so abort can reverse it, and the size and
+// counters of the folders are queued instead of walked up the tree on every change; the queue is
+// applied in one pass, deepest folder first, at commit or when a query needs the counters
+
+// opens a transaction owned by the current session
+void VFS::begin() {
+    if (in_transaction) {
+        throw runtime_error("A transaction is already open");
+    }
+
+    in_transaction = true;
+    transaction_owner = session_id;
+}
+
+// applies the counters of the open transaction and keeps its changes
+// -- only the session that began the transaction may end it
+void VFS::commit() {
+    if (!in_transaction) {
+        throw runtime_error("No transaction is open");
+    }
+    if (session_id != transaction_owner) {
+        throw runtime_error("The transaction belongs to another client");
+    }
+
+    // updates every changed folder once
+    settleStats();
+
+    // the watches see the events of the transaction only once it is kept
+    for (int i = 0; i < staged.size(); i++) {
+        staged[i].watch->ring.push(staged[i].event);
+    }
+    staged.clear();
+
+    // forgets the saved counters and the undo log
+    for (int i = 0; i < dirty.size(); i++) {
+        dirty[i].node->dirty = -1;
+    }
+    dirty.clear();
+
+    // drops the saved contents of written files, so the files own their extents again
+    for (int i = 0; i < undo_log.size(); i++) {
+        undo_log[i].data = FileData();
+    }
+    undo_log.clear();
+
+    in_transaction = false;
+}
+
+// rolls back every change of the open transaction
+void VFS::abort() {
+    if (!in_transaction) {
+        throw runtime_error("No transaction is open");
+    }
+    if (session_id != transaction_owner) {
+        throw runtime_error("The transaction belongs to another client");
+    }
+
+    // nodes created by the transaction are about to be deleted
+    if (open_walks > 0) {
+        throw runtime_error("Cannot abort while a walk is in progress");
+    }
+
+    // keeps the working folders as paths, they may be deleted by the rollback
+    Session session = getSession();
+
+    // puts back the counters every changed folder had before the transaction
+    // -- the queued changes are dropped, so the undo below does not touch counters
+    for (int i = 0; i < dirty.size(); i++) {
+        dirty[i].node->inode->size = dirty[i].size;
+        dirty[i].node->inode->stats = dirty[i].stats;
+        dirty[i].node->dirty = -1;
+    }
+    dirty.clear();
+    unsettled.clear();
+    queued_bytes = queued_nodes = queued_links = 0;
+
+    // the watches never see the events of a rolled back transaction
+    staged.clear();
+
+    // reverses the mutations, newest first, so every node finds the tree as it left it
+    for (int i = undo_log.size() - 1; i >= 0; i--) {
+        undo(undo_log[i]);
+        undo_log[i].data = FileData();
+    }
+    undo_log.clear();
+
+    in_transaction = false;
+    tag_epoch++;
+
+    // returns to the working folders if they still exist
+    setSession(session);
+}
+
+// throws if a session other than the current one has a transaction open
+// -- its abort would roll back every change made meanwhile, so the other sessions cannot change
+//    the tree until it ends
+void VFS::checkOwner() {
+    if (in_transaction && session_id != transaction_owner) {
+        throw runtime_error("Another client has a transaction open");
+    }
+}
+
+// returns true while a transaction is open
+bool VFS::inTransaction() {
+    return in_transaction;
+}
+
+// returns the id of the session that began the open transaction
+int VFS::transactionOwner() {
+    return transaction_owner;
+}
+
+// updates the counters of the folders from first up to, not including, stop
+// -- in a transaction only first is marked; settleStats carries the change up to the root
+void VFS::chargeStats(Node *first, Node *stop, Node *ptr, bool add) {
+    if (!in_transaction) {
+        if (add) {
+            addStats(first, stop, ptr);
+        }
+        else {
+            subtractStats(first, stop, ptr);
+        }
+        return;
+    }
+
+    // variables for the entry of the folder and the sign of the change
+    int index = markDirty(first);
+    DirtyFolder& entry = dirty[index];
+    int64_t sign = add ? 1 : -1;
+
+    entry.size_delta += sign * int64_t(ptr->inode->size);
+    entry.files_delta += sign * int64_t(ptr->inode->stats.files);
+    entry.folders_delta += sign * int64_t(ptr->inode->stats.folders);
+    entry.links_delta += sign * int64_t(ptr->inode->stats.links);
+
+    // an added subtree can only raise the largest file, a removed one may lower it
+    // -- the added bytes and nodes bound how far the totals may grow before they are applied
+    if (add) {
+        queued_bytes = (ptr->inode->size > UINT64_MAX - queued_bytes) ? UINT64_MAX : queued_bytes + ptr->inode->size;
+        queued_nodes += ptr->inode->stats.files + ptr->inode->stats.folders;
+        queued_links += ptr->inode->stats.links;
+        entry.grown_max = max(entry.grown_max, ptr->inode->stats.max_file);
+    }
+    else {
+        entry.shrunk = true;
+    }
+
+    if (!entry.queued) {
+        entry.queued = true;
+        unsettled.push_back(index);
+    }
+}
+
+// adds bytes to the sizes of the folders from first up to, not including, stop
+// -- in a transaction first takes the bytes and stop gives them back, since settleStats carries both
+//    up to the top; a stop above the top of first is never reached, so it is not marked
+void VFS::chargeBytes(Node *first, Node *stop, int64_t bytes) {
+    if (!in_transaction) {
+        for (Node* curr = first; curr != stop; curr = curr->parent) {
+            curr->inode->size += bytes;
+        }
+        return;
+    }
+
+    // variables for the folders marked and the bytes each takes
+    Node* folders[2] = {first, (stop != getTop(first)->parent) ? stop : nullptr};
+    int64_t deltas[2] = {bytes, -bytes};
+
+    for (int i = 0; i < 2 && folders[i] != nullptr; i++) {
+        int index = markDirty(folders[i]);
+        DirtyFolder& entry = dirty[index];
+        entry.size_delta += deltas[i];
+
+        if (deltas[i] > 0) {
+            queued_bytes = (uint64_t(deltas[i]) > UINT64_MAX - queued_bytes) ? UINT64_MAX : queued_bytes + deltas[i];
+        }
+
+        if (!entry.queued) {
+            entry.queued = true;
+            unsettled.push_back(index);
+        }
+    }
+}
+
+// corrects the sizes chargeStats gave the folders from first up to stop for the hard-linked files under ptr
+// -- a folder holding another name of a file already counts its bytes, so it neither gains them when
+//    ptr is added under first nor loses them when ptr leaves
+void VFS::chargeLinks(Node *first, Node *stop, Node *ptr, bool add) {
+    settleLinks();
+    if (ptr->inode->stats.links == 0) {
+        return;
+    }
+
+    Vector<Node*> files;
+    linkedFiles(ptr, files);
+
+    for (int i = 0; i < files.size(); i++) {
+        // a file with several names under ptr is corrected once
+        int seen = 0;
+        while (files[seen]->inode != files[i]->inode) {
+            seen++;
+        }
+        if (seen < i) {
+            continue;
+        }
+
+        // only the folders below stop were charged
+        Node* held = getLinkHolder(first, files[i], ptr);
+        Node* curr = first;
+        while (curr != stop && curr != held) {
+            curr = curr->parent;
+        }
+
+        if (held != nullptr && curr == held) {
+            int64_t bytes = int64_t(files[i]->inode->size);
+            chargeBytes(held, stop, add ? -bytes : bytes);
+        }
+    }
+}
+
+// returns the index of the dirty entry of a folder, saving its counters the first time
+int VFS::markDirty(Node *ptr) {
+    if (ptr->dirty < 0) {
+        DirtyFolder entry = {ptr, ptr->inode->size, ptr->inode->stats, 0, 0, 0, 0, 0, false, false};
+        ptr->dirty = dirty.size();
+        dirty.push_back(entry);
+    }
+
+    return ptr->dirty;
+}
+
+// applies the queued counters of the open transaction
+// -- each folder is applied after every folder below it and passes its change to its parent,
+// -- so the folders above many changes are updated once
+void VFS::settleStats() {
+    if (unsettled.empty()) {
+        return;
+    }
+
+    // groups the queued folders by depth
+    // -- depths are read now, since moves may have changed them
+    Vector<Vector<int>> levels;
+    for (int i = 0; i < unsettled.size(); i++) {
+        int depth = getDepth(dirty[unsettled[i]].node);
+        while (levels.size() <= depth) {
+            levels.push_back(Vector<int>());
+        }
+        levels[depth].push_back(unsettled[i]);
+    }
+    unsettled.clear();
+    queued_bytes = queued_nodes = queued_links = 0;
+
+    for (int depth = levels.size() - 1; depth >= 0; depth--) {
+        for (int i = 0; i < levels[depth].size(); i++) {
+            // variables for the folder and its largest file before the change
+            DirtyFolder* entry = &dirty[levels[depth][i]];
+            Node* ptr = entry->node;
+            uint64_t old_max = ptr->inode->stats.max_file;
+
+            ptr->inode->size += entry->size_delta;
+            ptr->inode->stats.files += entry->files_delta;
+            ptr->inode->stats.folders += entry->folders_delta;
+            ptr->inode->stats.links += entry->links_delta;
+
+            // the children are final, so a lowered maximum is recomputed from them
+            // -- a raised one is held by at least one child
+            if (entry->shrunk) {
+                refreshLevel(ptr);
+            }
+            else if (entry->grown_max > ptr->inode->stats.max_file) {
+                ptr->inode->stats.max_file = entry->grown_max;
+                ptr->inode->stats.max_count = 1;
+            }
+
+            // variables for the change passed to the parent
+            int64_t size_delta = entry->size_delta;
+            int64_t files_delta = entry->files_delta;
+            int64_t folders_delta = entry->folders_delta;
+            int64_t links_delta = entry->links_delta;
+            bool changed = size_delta != 0 || files_delta != 0 || folders_delta != 0 || links_delta != 0 ||
+                           ptr->inode->stats.max_file != old_max;
+
+            entry->size_delta = entry->files_delta = entry->folders_delta = entry->links_delta = 0;
+            entry->grown_max = 0;
+            entry->shrunk = entry->queued = false;
+
+            // a folder in the bin keeps its counters for recover but no longer adds to its old parent
+            Node* parent = ptr->parent;
+            if (!changed || parent == nullptr || ptr->slot >= parent->children.size() || parent->children[ptr->slot] != ptr) {
+                continue;
+            }
+
+            int index = markDirty(parent);
+            DirtyFolder& above = dirty[index];
+
+            above.size_delta += size_delta;
+            above.files_delta += files_delta;
+            above.folders_delta += folders_delta;
+            above.links_delta += links_delta;
+
+            if (ptr->inode->stats.max_file < old_max) {
+                above.shrunk = true;
+            }
+            else {
+                above.grown_max = max(above.grown_max, ptr->inode->stats.max_file);
+            }
+
+            if (!above.queued) {
+                above.queued = true;
+                levels[depth - 1].push_back(index);
+            }
+        }
+    }
+}
+
+// records how to reverse a mutation, before it changes ptr
+// -- path is the bin path of a node taken out of the bin
+void VFS::logUndo(UndoType type, Node *ptr, string path) {
+    if (!in_transaction) {
+        return;
+    }
+
+    UndoRecord record = {type, ptr, ptr->parent, ptr->slot, ptr->name, path, FileData(), 0, Quota{0, 0}};
+
+    // a written file keeps its old content, sharing the extents the write does not touch
+    if (type == undo_write) {
+        record.data = ptr->inode->data;
+        record.size = ptr->inode->size;
+    }
+
+    // a folder keeps its old limits
+    if (type == undo_quota) {
+        record.limits = (ptr->inode->quota != nullptr) ? *ptr->inode->quota : Quota{0, 0};
+    }
+    undo_log.push_back(record);
+}
+
+// reverses one mutation without touching counters
+void VFS::undo(UndoRecord &record) {
+    Node* ptr = record.node;
+
+    switch (record.type) {
+        // deletes a created node
+        case undo_create:
+            indexSubtree(ptr, false);
+            detachChild(ptr);
+            removeNode(ptr);
+            break;
+
+        // takes a removed node back out of the bin
+        case undo_remove:
+            bin.dequeue_rear();
+            bin_paths.dequeue_rear();
+            attachChildAt(record.parent, ptr, record.slot);
+            indexSubtree(ptr, true);
+            break;
+
+        // puts a moved node back under its old name
+        case undo_move:
+            detachChild(ptr);
+            ptr->name = record.name;
+            attachChildAt(record.parent, ptr, record.slot);
+            break;
+
+        // returns a recovered node to the front of the bin
+        // -- the node may have been recovered into a folder that took the old path, so it gets
+        //    its old parent back before that folder is deleted
+        case undo_recover:
+            indexSubtree(ptr, false);
+            detachChild(ptr);
+            ptr->parent = record.parent;
+            bin.enqueue_front(ptr);
+            bin_paths.enqueue_front(record.path);
+            break;
+
+        // gives a written file its old content and size back, under every name in the tree
+        case undo_write: {
+            Vector<Node*> names;
+            getNames(ptr, names);
+
+            for (int i = 0; i < names.size(); i++) {
+                if (isAttached(names[i])) {
+                    size_index.erase(ptr->inode->size, names[i]);
+                    size_index.insert(record.size, names[i]);
+                }
+            }
+
+            ptr->inode->data = record.data;
+            ptr->inode->size = record.size;
+            ptr->inode->stats.max_file = record.size;
+            break;
+        }
+
+        // returns a skipped node from the end to the front of the bin
+        case undo_skip:
+            bin.enqueue_front(bin.dequeue_rear());
+            bin_paths.enqueue_front(bin_paths.dequeue_rear());
+            break;
+
+        // the folders get their old counters back, so the file is no longer counted as linked
+        case undo_link:
+            ptr->inode->stats.links = 0;
+            break;
+
+        // gives a folder its old limits back
+        case undo_quota:
+            delete ptr->inode->quota;
+            ptr->inode->quota = (record.limits.bytes == 0 && record.limits.nodes == 0) ? nullptr : new Quota(record.limits);
+            break;
+    }
+}
+
+// ---------------- SNAPSHOTS -------------------------
+// a snapshot is a copy-on-write clone of the root, so creating one is constant time; every later
+// change first has each snapshot folder on its path take the children slot by slot, and clones
+// only the next node on the path into it, so only that path is copied, and versions that still
+// share a folder can be compared by pointer without reading it
+
+// records the tree under a name
+void VFS::snapshotCreate(string name) {
+    // checks if the name is valid and unique
+    if (name.empty() || !isValid(name, folder)) {
+        throw runtime_error("Snapshot name is not valid");
+    }
+    if (findSnapshot(name) >= 0) {
+        throw runtime_error("Snapshot name is not unique");
+    }
+
+    // undo does not expand clones, so the tree must not change under a snapshot before commit
+    if (in_transaction) {
+        throw runtime_error("Cannot take a snapshot during a transaction");
+    }
+
+    Snapshot snapshot = {name, cloneNode(root, nullptr, true), timestampNow()};
+    snapshots.push_back(snapshot);
+}
+
+// returns the snapshots, oldest first
+const Vector<Snapshot>& VFS::snapshotList() {
+    return snapshots;
+}
+
+// returns the differences from one snapshot to another, or to the tree if to is empty
+Vector<DiffEntry> VFS::snapshotDiff(string from, string to) {
+    // gets both versions
+    int from_index = findSnapshot(from);
+    int to_index = to.empty() ? -1 : findSnapshot(to);
+
+    if (from_index < 0 || (!to.empty() && to_index < 0)) {
+        throw runtime_error("Snapshot does not exist");
+    }
+
+    // the counters of the tree include the queued changes of a transaction
+    settleStats();
+
+    Vector<DiffEntry> changes;
+    diffNodes(snapshots[from_index].root, to.empty() ? root : snapshots[to_index].root, "", changes);
+    return changes;
+}
+
+// replaces the tree with a snapshot
+// -- the snapshot is kept; the replaced tree and the bin are deleted
+void VFS::snapshotRestore(string name) {
+    int index = findSnapshot(name);
+    if (index < 0) {
+        throw runtime_error("Snapshot does not exist");
+    }
+
+    // the nodes about to be deleted may be logged or on a walk
+    if (in_transaction) {
+        throw runtime_error("Cannot restore a snapshot during a transaction");
+    }
+    if (open_walks > 0) {
+        throw runtime_error("Cannot restore a snapshot while a walk is in progress");
+    }
+
+    // keeps the working folders as paths, to find them in the restored tree
+    Session session = getSession();
+
+    // nodes in the bin point into the replaced tree, or at folders removed after them, so they leave
+    // their old folders before any is deleted
+    Vector<Node*> purged;
+    while (!bin.isEmpty()) {
+        purged.push_back(bin.dequeue());
+        bin_paths.dequeue();
+        purged.back()->parent = nullptr;
+    }
+    for (int i = 0; i < purged.size(); i++) {
+        removeNode(purged[i]);
+    }
+
+    // keeps the paths of the watched folders, to move the watches to the same folders in the restored tree
+    Vector<Watch*> moved;
+    Vector<string> moved_paths;
+    for (int i = 0; i < watches.size(); i++) {
+        if (watches[i]->folder != nullptr) {
+            moved.push_back(watches[i]);
+            moved_paths.push_back(getPath(watches[i]->folder));
+        }
+    }
+
+    // the restored tree is a clone of the snapshot, so the snapshot stays unchanged
+    Node* old_root = root;
+    root = cloneNode(snapshots[index].root, nullptr, true);
+
+    // a watch whose path leads through folders of the restored tree moves there, the others end with
+    // the old tree
+    // -- the path is read name by name, so a link in the restored tree is never followed
+    for (int i = 0; i < moved.size(); i++) {
+        Node* ptr = root;
+        size_t start = 1;
+        while (ptr != nullptr && start < moved_paths[i].size()) {
+            size_t end = moved_paths[i].find('/', start);
+            if (end == string::npos) {
+                end = moved_paths[i].size();
+            }
+
+            ptr = getChild(ptr, moved_paths[i].substr(start, end - start));
+            if (ptr != nullptr && ptr->inode->type != folder) {
+                ptr = nullptr;
+            }
+            start = end + 1;
+        }
+
+        if (ptr == nullptr) {
+            continue;
+        }
+
+        detachWatch(moved[i]);
+        attachWatch(moved[i], ptr);
+    }
+
+    // deleting the old tree expands the clones that still share it
+    removeNode(old_root);
+
+    // only the expanded part of the restored tree is indexed, the rest is added as it expands
+    size_index.clear();
+    time_index.clear();
+    indexSubtree(root, true);
+
+    curr_Node = root;
+    prev_Node = root;
+    tag_epoch++;
+    setSession(session);
+}
+
+// drops a snapshot
+void VFS::snapshotDelete(string name) {
+    int index = findSnapshot(name);
+    if (index < 0) {
+        throw runtime_error("Snapshot does not exist");
+    }
+
+    removeNode(snapshots[index].root);
+    snapshots.erase(index);
+}
+
+// returns the index of the snapshot with the given name, -1 if there is none
+int VFS::findSnapshot(string name) {
+    for (int i = 0; i < snapshots.size(); i++) {
+        if (snapshots[i].name == name) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// adds the differences between two versions of the folder at path
+// -- versions reading the same children are equal, so shared subtrees are skipped unread
+void VFS::diffNodes(Node *from, Node *to, string path, Vector<DiffEntry> &changes) {
+    // reads the children through the source of a copy-on-write clone instead of expanding it
+    Node* from_source = from->readSource();
+    Node* to_source = to->readSource();
+
+    if (from_source == to_source) {
+        return;
+    }
+
+    // pairs up the children by name
+    Vector<Node*> left(from_source->children);
+    Vector<Node*> right(to_source->children);
+    mergeSort(left, true);
+    mergeSort(right, true);
+
+    int i = 0;
+    int j = 0;
+    while (i < left.size() || j < right.size()) {
+        // a name only on one side was removed or added
+        if (j == right.size() || (i < left.size() && left[i]->name < right[j]->name)) {
+            DiffEntry change = {'-', path + '/' + left[i]->name};
+            changes.push_back(change);
+            i++;
+        }
+        else if (i == left.size() || right[j]->name < left[i]->name) {
+            DiffEntry change = {'+', path + '/' + right[j]->name};
+            changes.push_back(change);
+            j++;
+        }
+        // a name on both sides is compared, folders recursively
+        else {
+            Node* before = left[i++];
+            Node* after = right[j++];
+
+            if (before->inode->type != after->inode->type || (before->inode->type != folder &&
+                (before->inode->size != after->inode->size || before->inode->time_created != after->inode->time_created))) {
+                DiffEntry change = {'~', path + '/' + after->name};
+                changes.push_back(change);
+            }
+            else if (before->inode->type == folder) {
+                diffNodes(before, after, path + '/' + after->name, changes);
+            }
+        }
+    }
+}
+
+// ---------------- TREE FILE DIFF AND SYNC -------------------------
+// the tree is flattened and compared with a vfs.dat file by Merkle hashes (treediff.hpp)
+
+// returns the differences from the tree to the tree in a file
+Vector<TreeChange> VFS::diff(string filename) {
+    // reads the other tree
+    ifstream input(filename, ios::in);
+    if (!input) {
+        throw runtime_error("File failed to open");
+    }
+
+    Vector<DatEntry> other;
+    readTree(input, other);
+
+    // flattens the tree, with the queued changes of a transaction applied
+    settleStats();
+
+    Vector<DatEntry> current;
+    flatten(root, -1, current);
+    hashTree(current);
+
+    Vector<TreeChange> changes;
+    diffTrees(current, other, changes);
+    return changes;
+}
+
+// changes the tree to match the tree in a file with the fewest mutations the diff allows
+// -- runs in its own transaction unless one is open, so a failure leaves the tree unchanged; inside
+//    the caller's transaction the steps done before a failure stay until the caller aborts
+int VFS::sync(string filename) {
+    checkOwner();
+
+    // reads the other tree
+    ifstream input(filename, ios::in);
+    if (!input) {
+        throw runtime_error("File failed to open");
+    }
+
+    Vector<DatEntry> other;
+    readTree(input, other);
+
+    // plans the mutations from the differences
+    settleStats();
+
+    Vector<DatEntry> current;
+    flatten(root, -1, current);
+    hashTree(current);
+
+    Vector<TreeChange> changes;
+    Vector<SyncStep> steps;
+    diffTrees(current, other, changes);
+    planSync(other, changes, steps);
+
+    // keeps the working folders, the steps run in other folders
+    Session session = getSession();
+    bool own = !in_transaction;
+    if (own) {
+        begin();
+    }
+
+    try {
+        for (int i = 0; i < steps.size(); i++) {
+            if (steps[i].op == sync_mv) {
+                mv(steps[i].dir, steps[i].name);
+                continue;
+            }
+
+            // the other mutations run in the current folder
+            curr_Node = (steps[i].dir == "/") ? root : getNode(steps[i].dir);
+            if (curr_Node == nullptr || curr_Node->inode->type != folder) {
+                throw runtime_error("Invalid path");
+            }
+
+            switch (steps[i].op) {
+                case sync_mkdir:
+                    mkdir(steps[i].name);
+                    break;
+                case sync_touch:
+                    touch(steps[i].name, steps[i].size);
+                    break;
+                case sync_symlink:
+                    ln(steps[i].target, steps[i].name, true);
+                    break;
+                default:
+                    rm(steps[i].name);
+                    break;
+            }
+        }
+    }
+    catch (exception &e) {
+        setSession(session);
+        if (own) {
+            abort();
+        }
+        throw;
+    }
+
+    setSession(session);
+    if (own) {
+        commit();
+    }
+
+    return steps.size();
+}
+
+// appends the subtree under ptr to a flattened tree in preorder, without expanding clones
+void VFS::flatten(Node *ptr, int parent, Vector<DatEntry> &entries) {
+    DatEntry entry = {ptr->name, ptr->inode->type, ptr->inode->size, ptr->inode->time_created,
+                      (ptr->inode->type == symbolic_link) ? readLink(ptr) : "", parent, 0, 0, 0};
+    int index = entries.size();
+    entries.push_back(entry);
+
+    // reads the children through the source of a copy-on-write clone
+    Node* source = ptr->readSource();
+    for (int i = 0; i < source->children.size(); i++) {
+        flatten(source->children[i], index, entries);
+    }
+
+    entries[index].end = entries.size();
+}
+
+// ---------------- FILE CONTENT -------------------------
+// a file holds its bytes in a FileData (filedata.hpp) and its size is the end of the last byte
+// written, or the size it was truncated or touched to; the bytes are not saved in vfs.dat, so a
+// loaded file is a hole of its saved size
+
+// writes bytes at offset into the file at path, creating it if needed
+// -- writing past the end leaves a hole between the old end and offset
+void VFS::write(string path, uint64_t offset, const string &bytes) {
+    checkOwner();
+
+    if (offset > MAX_FILE_BYTES || bytes.size() > MAX_FILE_BYTES - offset) {
+        throw runtime_error("File is too large");
+    }
+
+    Node* ptr = getFile(path, true);
+    checkResize(ptr, offset + bytes.size());
+
+    // stops copies from sharing the folders holding the file
+    prepareInode(ptr);
+    logUndo(undo_write, ptr, "");
+
+    ptr->inode->data.write(offset, bytes.data(), bytes.size(), dedup);
+    resizeFile(ptr, max(ptr->inode->size, offset + bytes.size()));
+    ptr->inode->time_modified = timestampNow();
+    notifyModified(ptr);
+}
+
+// writes bytes at the end of the file at path, creating it if needed
+void VFS::append(string path, const string &bytes) {
+    checkOwner();
+
+    Node* ptr = getFile(path, true);
+    write(path, ptr->inode->size, bytes);
+}
+
+// makes bytes the whole content of the file at path, creating it if needed
+// -- one mutation, so a watch sees one event and a transaction logs one undo record
+void VFS::overwrite(string path, const string &bytes) {
+    checkOwner();
+
+    if (bytes.size() > MAX_FILE_BYTES) {
+        throw runtime_error("File is too large");
+    }
+
+    Node* ptr = getFile(path, true);
+    checkResize(ptr, bytes.size());
+
+    // stops copies from sharing the folders holding the file
+    prepareInode(ptr);
+    logUndo(undo_write, ptr, "");
+
+    // drops the old bytes past the new end before writing over the rest
+    if (bytes.size() < ptr->inode->size) {
+        ptr->inode->data.cut(bytes.size());
+    }
+    ptr->inode->data.write(0, bytes.data(), bytes.size(), dedup);
+    resizeFile(ptr, bytes.size());
+    ptr->inode->time_modified = timestampNow();
+    notifyModified(ptr);
+}
+
+// changes the size of the file at path, dropping the bytes past a smaller size
+// -- a larger size adds a hole, which takes no pages
+void VFS::truncate(string path, uint64_t size) {
+    checkOwner();
+
+    if (size > MAX_FILE_BYTES) {
+        throw runtime_error("File is too large");
+    }
+
+    Node* ptr = getFile(path, false);
+    checkResize(ptr, size);
+
+    // stops copies from sharing the folders holding the file
+    prepareInode(ptr);
+    logUndo(undo_write, ptr, "");
+
+    if (size < ptr->inode->size) {
+        ptr->inode->data.cut(size);
+    }
+    resizeFile(ptr, size);
+    ptr->inode->time_modified = timestampNow();
+    notifyModified(ptr);
+}
+
+// opens a read of the content of a file, read with nextSpans
+// -- params: [-o offset] [-n length] <path>
+ReadCursor VFS::cat(string params) {
+    // variables for the read options
+    uint64_t offset = 0;
+    uint64_t length = UINT64_MAX;
+    string path;
+
+    // parses the read options
+    stringstream sstr(params);
+    string token;
+    while (sstr >> token) {
+        if (token == "-o" || token == "-n") {
+            // reads the number following the option
+            uint64_t value;
+            if (!(sstr >> value)) {
+                throw runtime_error("Invalid parameter");
+            }
+
+            (token == "-o" ? offset : length) = value;
+        }
+        else if (path.empty()) {
+            path = token;
+        }
+        else {
+            throw runtime_error("Invalid parameter");
+        }
+    }
+
+    Node* ptr = getFile(path, false);
+    ptr->inode->time_accessed = timestampNow();
+
+    // the read stops at the end of the file
+    ReadCursor cursor;
+    cursor.file = ptr;
+    cursor.offset = min(offset, ptr->inode->size);
+    cursor.end = cursor.offset + min(length, ptr->inode->size - cursor.offset);
+    return cursor;
+}
+
+// turns deduplication of written bytes on or off
+// -- bytes already written keep the runs they are in
+void VFS::setDedup(bool on) {
+    dedup = on;
+}
+
+// returns true if written bytes are deduplicated
+bool VFS::getDedup() {
+    return dedup;
+}
+
+// points batch at up to max spans of the next bytes of a read and returns how many were written, 0 once it is done
+// -- the spans point into the pages of the file, holes into a shared page of zeros
+int VFS::nextSpans(ReadCursor &cursor, iovec *batch, int max) {
+    return cursor.file->inode->data.read(cursor.offset, cursor.end, batch, max);
+}
+
+// ---------------- DATA METHODS -------------------------
+// return results as values instead of printing them
+
+// returns the node at a path, a child name, or the current folder for an empty path
+// -- a symbolic link at the end of the path is followed unless follow is false
+Node* VFS::resolve(string path, bool follow) {
+    if (path.empty()) {
+        return curr_Node;
+    }
+
+    // a plain child name skips the path walk
+    if (path.find('/') == string::npos && path != "." && path != "..") {
+        Node* ptr = getChild(curr_Node, path);
+        int hops = 0;
+        return (follow && ptr != nullptr && ptr->inode->type == symbolic_link) ? followLink(ptr, hops) : ptr;
+    }
+
+    return getNode(path, follow);
+}
+
+// fills entries with a copy of every child of the folder at path
+void VFS::listEntries(string path, Vector<Entry> &entries) {
+    // gets the folder to list
+    Node* ptr = resolve(path);
+
+    // check if a valid folder was returned
+    if (ptr == nullptr || ptr->inode->type != folder) {
+        throw runtime_error("Invalid path");
+    }
+
+    // the copied sizes include the queued changes of a transaction
+    settleStats();
+
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    // copies each child
+    for (int i = 0; i < ptr->children.size(); i++) {
+        Node* child = ptr->children[i];
+        Entry entry = {child->name, child->inode->type, child->inode->size, child->inode->time_created, child->inode->time_modified, child->inode->time_accessed};
+        entries.push_back(entry);
+    }
+}
+
+// fills names with the paths completing the last name of path, folders ending with '/'
+// -- the last name is a prefix, so a large folder answers from its sorted children in
+//    O(log n + matches); a path that leads nowhere has no completions
+void VFS::completeNames(string path, Vector<string> &names) {
+    // splits the folder as typed from the start of the last name
+    size_t slash = path.find_last_of('/');
+    string dir = (slash == string::npos) ? "" : path.substr(0, slash + 1);
+    string prefix = path.substr(dir.size());
+
+    Node* ptr = resolve(dir);
+    if (ptr == nullptr || ptr->inode->type != folder) {
+        return;
+    }
+
+    // an empty prefix lists the whole folder
+    ListCursor cursor = openList(ptr, prefix, 0);
+    Node* batch[LIST_BATCH];
+    int count;
+
+    while ((count = nextBatch(cursor, batch, LIST_BATCH)) > 0) {
+        for (int i = 0; i < count; i++) {
+            // a link is completed like the node it leads to, so a linked folder can be entered
+            // -- a loop of links completes like a file
+            Node* target = batch[i];
+            if (target->inode->type == symbolic_link) {
+                int hops = 0;
+                try {
+                    target = followLink(target, hops);
+                }
+                catch (runtime_error &error) {
+                    target = nullptr;
+                }
+            }
+
+            bool is_folder = (target != nullptr && target->inode->type == folder);
+            names.push_back(dir + batch[i]->name + (is_folder ? "/" : ""));
+        }
+    }
+}
+
+// ---------------- RESUMABLE WALKS -------------------------
+// long operations run a bounded number of nodes per step, so a caller can interleave other work
+// -- while a walk is open, emptybin refuses to delete nodes, so the stack never dangles
+
+// opens a walk starting at the node at path
+void VFS::openWalk(Walk &walk, string path) {
+    // gets the node to start from
+    Node* ptr = (path == root->name) ? root : resolve(path);
+
+    // check if a valid node was returned
+    if (ptr == nullptr) {
+        throw runtime_error("Invalid path");
+    }
+
+    // the walked sizes include the queued changes of a transaction
+    settleStats();
+
+    walk.stack.clear();
+    walk.stack.push_back(ptr);
+    open_walks++;
+}
+
+// closes a walk, finished or not
+void VFS::closeWalk(Walk &walk) {
+    walk.stack.clear();
+    open_walks--;
+}
+
+// returns true while a walk is open
+bool VFS::walksOpen() {
+    return open_walks > 0;
+}
+
+// visits up to budget nodes of a walk, adding the path of those named name
+// -- returns true once the walk is finished
+bool VFS::findStep(Walk &walk, string name, Vector<string> &paths, int budget) {
+    for (; budget > 0 && !walk.stack.empty(); budget--) {
+        // takes the next node
+        Node* ptr = walk.stack.back();
+        walk.stack.erase(walk.stack.size() - 1);
+
+        // expands the folder if it is a copy-on-write clone
+        materialize(ptr);
+
+        // checks the children, as find does, so the start itself is not reported
+        for (int i = ptr->children.size() - 1; i >= 0; i--) {
+            if (ptr->children[i]->name == name) {
+                paths.push_back(getPath(ptr->children[i]));
+            }
+            walk.stack.push_back(ptr->children[i]);
+        }
+    }
+
+    return walk.stack.empty();
+}
+
+// writes up to budget nodes of a walk in the vfs.dat format
+// -- returns true once the walk is finished
+bool VFS::writeStep(Walk &walk, ofstream &fout, int budget) {
+    for (; budget > 0 && !walk.stack.empty(); budget--) {
+        // takes the next node in the order write uses
+        Node* ptr = walk.stack.back();
+        walk.stack.erase(walk.stack.size() - 1);
+
+        writeLine(fout, ptr);
+
+        // expands the folder if it is a copy-on-write clone
+        materialize(ptr);
+
+        // pushes the children last first, so the first one is written next
+        for (int i = ptr->children.size() - 1; i >= 0; i--) {
+            walk.stack.push_back(ptr->children[i]);
+        }
+    }
+
+    return walk.stack.empty();
+}
+
+// empties the bin into a walk that deletes its nodes with removeStep
+// -- the bin is empty as soon as this returns; the walk is not counted as open
+void VFS::takeBin(Walk &walk) {
+    // an abort may still put the nodes back
+    if (in_transaction) {
+        throw runtime_error("Cannot empty the bin during a transaction");
+    }
+
+    // the watches hear of every node before the walk deletes any
+    while (!bin.isEmpty()) {
+        Node* ptr = bin.dequeue();
+        bin_paths.dequeue();
+        notify(ptr->parent, ptr->name, ptr->inode->type, watch_purged, 0);
+        leaveNode(ptr);
+        walk.stack.push_back(ptr);
+    }
+
+    // the nodes leave their old folders before the walk deletes any, as one may be the folder
+    // another was removed from
+    for (int i = 0; i < walk.stack.size(); i++) {
+        walk.stack[i]->parent = nullptr;
+    }
+}
+
+// moves the working folders to the root if they lie under a node about to be deleted
+// -- cd - can lead back into a folder that was removed to the bin since
+void VFS::leaveNode(Node *ptr) {
+    if (isUnder(curr_Node, ptr)) {
+        curr_Node = root;
+    }
+    if (isUnder(prev_Node, ptr)) {
+        prev_Node = root;
+    }
+}
+
+// deletes up to budget nodes taken from the bin
+// -- returns true once every node is deleted
+bool VFS::removeStep(Walk &walk, int budget) {
+    for (; budget > 0 && !walk.stack.empty(); budget--) {
+        // takes the next node
+        Node* ptr = walk.stack.back();
+        walk.stack.erase(walk.stack.size() - 1);
+
+        // a clone that was never expanded only has to leave its source
+        unshare(ptr);
+
+        // clones still sharing the children of ptr take their own copy first
+        while (ptr->cow_clones != nullptr) {
+            materialize(ptr->cow_clones->back());
+        }
+
+        // the children are deleted by later steps, and no longer point at the deleted folder
+        for (int i = 0; i < ptr->children.size(); i++) {
+            ptr->children[i]->parent = nullptr;
+            walk.stack.push_back(ptr->children[i]);
+        }
+
+        endWatches(ptr);
+        delete ptr;
+    }
+
+    return walk.stack.empty();
+}
+
+// ---------------- HELPER METHODS -------------------------
+
+// returns the path of the current node
+string VFS::getPath(Node *ptr) {
+    // checks if the current node is the root
+    if (ptr->name ==  root->name) {
+        return "";
+    }
+    else {
+        return getPath(ptr->parent) + '/' + ptr->name;
+    }
+}
+
+// checks if file or folder name is valid
+bool VFS::isValid(string name, NodeType type) {
+    // . and .. are read as the folder itself and its parent
+    if (name == "." || name == "..") {
+        return false;
+    }
+
+    // folder check
+    if (type == folder) {
+        // checks for every character in folder name
+        for (int i = 0; i < name.size(); i++) {
+            if ((int(name[i]) >= int('A') &&  int(name[i]) <= int('Z')) || 
+                (int(name[i]) >= int('a') && int(name[i]) <= int('z')) || 
+                (int(name[i]) >= int('0') && int(name[i]) <= int('9'))) {}
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+    else {
+        // checks for every character in file name
+        for (int i = 0; i < name.size(); i++) {
+            if ((int(name[i]) >= int('A') &&  int(name[i]) <= int('Z')) || 
+                (int(name[i]) >= int('a') && int(name[i]) <= int('z')) || 
+                (int(name[i]) >= int('0') && int(name[i]) <= int('9')) ||
+                (int(name[i]) == int('.'))) {}
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// checks if file or folder name is unique
+bool VFS::isUnique(string name, Node* curr_dir) {
+    return getChild(curr_dir, name) == nullptr;
+}
+
+// returns a specific child of given Node
+// -- a large folder is searched by name in its sorted children, a small one is scanned
+Node* VFS::getChild(Node *ptr, string childname) {
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    sortNames(ptr);
+    if (ptr->by_name != nullptr) {
+        SkipList<NameKey, Node*>::Entry* entry = nameBound(ptr, childname);
+        return (entry != nullptr && entry->value->name == childname) ? entry->value : nullptr;
+    }
+
+    for (int i = 0; i < ptr->children.size(); i++) {
+        if (ptr->children[i]->name == childname) {
+            return ptr->children[i];
+        }
+    }
+    return nullptr;
+}	
+
+// populates a vector with the matching nodes under ptr, whose path is path
+void VFS::getMatchingNode(Node *ptr, string path, string name, Vector<PathEntry>& matching_nodes) {
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    for (int i = 0; i < ptr->children.size(); i++) {
+        Node* child = ptr->children[i];
+        string child_path = path + '/' + child->name;
+
+        if (child->name == name) {
+            PathEntry found = {child, child_path};
+            matching_nodes.push_back(found);
+        }
+        getMatchingNode(child, child_path, name, matching_nodes);
+    }
+}
+
+//Helper method to get a pointer to Node at given path
+// -- symbolic links inside the path are followed, the one at its end only if follow is set
+Node* VFS::getNode(string path, bool follow) {
+    // variable for the links followed so far
+    int hops = 0;
+
+    return walkPath((!path.empty() && path[0] == '/') ? root : curr_Node, path, follow, hops);
+}
+
+// returns the node at a path read from a folder, nullptr if missing
+// -- empty parts and "." stay in the folder and ".." goes to its parent; hops counts the links
+//    followed on the way, so a loop of links ends with an error instead of running forever
+Node* VFS::walkPath(Node *ptr, const string &path, bool follow, int &hops) {
+    size_t start = 0;
+
+    while (ptr != nullptr && start <= path.size()) {
+        // variables for the next part of the path
+        size_t end = path.find('/', start);
+        if (end == string::npos) {
+            end = path.size();
+        }
+        string part = path.substr(start, end - start);
+        start = end + 1;
+
+        if (part.empty() || part == ".") {
+            continue;
+        }
+
+        if (part == "..") {
+            if (ptr->inode->type != folder) {
+                return nullptr;
+            }
+            ptr = (ptr == root) ? root : ptr->parent;
+            continue;
+        }
+
+        ptr = getChild(ptr, part);
+
+        // a link inside the path, or followed by a slash, always leads on
+        if (ptr != nullptr && ptr->inode->type == symbolic_link && (follow || end < path.size())) {
+            ptr = followLink(ptr, hops);
+        }
+    }
+
+    return ptr;
+}
+
+// returns the node a symbolic link leads to, nullptr if the path it holds is missing
+// -- a relative path is read from the folder holding the link
+Node* VFS::followLink(Node *ptr, int &hops) {
+    if (++hops > SYMLINK_HOPS) {
+        throw runtime_error("Too many levels of symbolic links");
+    }
+
+    string target = readLink(ptr);
+    return walkPath((target[0] == '/') ? root : ptr->parent, target, true, hops);
+}
+
+// returns the path held by a symbolic link
+string VFS::readLink(Node *ptr) {
+    // variables for the spans of the content
+    string target;
+    iovec spans[READ_BATCH];
+    uint64_t offset = 0;
+    int count;
+
+    while ((count = ptr->inode->data.read(offset, ptr->inode->size, spans, READ_BATCH)) > 0) {
+        for (int i = 0; i < count; i++) {
+            target.append((const char*)spans[i].iov_base, spans[i].iov_len);
+        }
+    }
+
+    return target;
+}
+
+// sorts a vector of node pointers by decreasing size, or by name if by_name is set
+void VFS::mergeSort(Vector<Node*>& container, bool by_name) {
+    // buffer for merging sorted runs
+    Vector<Node*> buffer(container.size());
+
+    // merges runs of doubling width
+    for (int width = 1; width < container.size(); width *= 2) {
+        for (int left = 0; left < container.size(); left += 2 * width) {
+            // variables for the bounds of the two runs
+            int mid = min(left + width, container.size());
+            int right = min(left + 2 * width, container.size());
+            int i = left, j = mid, k = left;
+
+            // takes the head that comes first, the left one on ties
+            while (i < mid && j < right) {
+                bool right_first = by_name ? (container[j]->name < container[i]->name) : (container[j]->inode->size > container[i]->inode->size);
+                buffer[k++] = right_first ? container[j++] : container[i++];
+            }
+            while (i < mid) {
+                buffer[k++] = container[i++];
+            }
+            while (j < right) {
+                buffer[k++] = container[j++];
+            }
+        }
+
+        // copies the merged runs back
+        for (int i = 0; i < container.size(); i++) {
+            container[i] = buffer[i];
+        }
+    }
+}
+
+// traverse and write recursively the vfs data
+void VFS::write(ofstream &fout, Node *ptr) {
+    // writes data corresponding to ptr to output stream
+    writeLine(fout, ptr);
+
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    // loops through the children of ptr
+    for (int i = 0; i < ptr->children.size(); i++) {
+        write(fout, ptr->children[i]);
+    }
+}
+
+// writes the line describing one node
+void VFS::writeLine(ofstream &fout, Node *ptr) {
+    if (ptr == root) {
+        fout << "/";
+    }
+    else {
+        fout << getPath(ptr);
+    }
+    fout << "," << ptr->inode->size << "," << ptr->inode->type << "," << ptr->inode->time_created << "," << ptr->inode->time_modified << "," << ptr->inode->time_accessed;
+
+    // a symbolic link ends with the path it holds
+    if (ptr->inode->type == symbolic_link) {
+        fout << "," << readLink(ptr);
+    }
+    fout << '\n';
+}
+
+// adds a subtree to a compressed file, in the order write uses
+void VFS::writeRecords(DatWriter &writer, Node *ptr, const string &path) {
+    writer.add(path, ptr->inode->size, ptr->inode->type, ptr->inode->time_created, ptr->inode->time_modified, ptr->inode->time_accessed,
+               (ptr->inode->type == symbolic_link) ? readLink(ptr) : "");
+
+    // expands the folder if it is a copy-on-write clone
+    materialize(ptr);
+
+    // the paths of the children are built from the path of the folder instead of its ancestors
+    for (int i = 0; i < ptr->children.size(); i++) {
+        writeRecords(writer, ptr->children[i], childPath(path, ptr->children[i]->name));
+    }
+}
+
+// helper method to load the vfs.dat
+void VFS::load(ifstream &fin) {
+    // a compressed file carries its own paths, so it is read without the state machine below
+    if (isCompressedDat(fin)) {
+        loadCompressed(fin);
+        return;
+    }
+
+    // variable to hold parameters
+    string params, curr_path;
+
+    // array to hold various parameters of the node
+    // 0 - name
+    // 1 - size
+    // 2 - type
+    // 3 - times: created,modified,accessed and the path a symbolic link holds, or the ctime text of older files
+    string paramsArray[4];
+
+    // variables for the times of a node
+    uint64_t created, modified, accessed;
+
+    // read parameters for root node
+    getline(fin, params);
+
+    // creates stringstream object of params
+    stringstream sstr(params);
+
+    // loops to get all params, the times are the rest of the line
+    for (int i = 0; i < 3; i++) {
+        getline(sstr, paramsArray[i], ',');
+    }
+    getline(sstr, paramsArray[3]);
+
+    // sets current path to the root
+    curr_path = paramsArray[0];
+
+    // creates the root node
+    parseTimes(paramsArray[3], created, modified, accessed);
+    root = new Node(paramsArray[0], nullptr, datType(stoi(paramsArray[2])), stoull(paramsArray[1]), created);
+    root->inode->time_modified = modified;
+    root->inode->time_accessed = accessed;
+
+    // makes current node root
+    curr_Node = root;
+
+    // checks for the end of the file
+    while (getline(fin, params)) {
+
+        // clears the sstr buffer
+        sstr.clear();
+
+        // creates stringstream object of params
+        sstr.str(params);
+
+        // loops to get all params, the times are the rest of the line
+        for (int i = 0; i < 3; i++) {
+            getline(sstr, paramsArray[i], ',');
+        }
+        getline(sstr, paramsArray[3]);
+
+        // searches for current path in read params
+        size_t found = paramsArray[0].find(curr_path);
+
+        // finds common parent 
+        while (found == string::npos) {
+            // finds last instance of '/' and removes from current path
+            found = curr_path.find_last_of('/');
+
+            if (found != curr_path.size() - 1) {
+                curr_Node = curr_Node->parent;
+            }
+
+            // updates current path
+            curr_path = curr_path.replace(found, curr_path.size(), "");
+            
+            // updates current path if moved up one level
+            if (curr_path.empty()) {
+                curr_path = "/";
+            }
+
+            // searches for current path in read params
+            found = paramsArray[0].find(curr_path);
+
+            if ((found != string::npos) && (curr_path.back() != '/')) {
+                curr_path += '/';
+            }
+        }
+
+
+        // replace portion of current path with ""
+        paramsArray[0].replace(found, curr_path.size(), "");
+
+        // checks if the after replacement, path still contains '/' at the begin
+        if (!paramsArray[0].empty() && paramsArray[0][0] == '/') {
+            paramsArray[0].erase(paramsArray[0].begin());
+        }
+
+        // creates new node
+        parseTimes(paramsArray[3], created, modified, accessed);
+        prev_Node = new Node(paramsArray[0], curr_Node, datType(stoi(paramsArray[2])), stoull(paramsArray[1]), created);
+        prev_Node->inode->time_modified = modified;
+        prev_Node->inode->time_accessed = accessed;
+
+        // a symbolic link holds the path at the end of the line
+        if (prev_Node->inode->type == symbolic_link) {
+            string target = datTarget(paramsArray[3]);
+            prev_Node->inode->data.write(0, target.data(), target.size(), false);
+        }
+        
+        // adds newNode to current node's children
+        attachChild(curr_Node, prev_Node);
+
+        // updates current path
+        curr_path = curr_path + paramsArray[0] + '/';
+
+        // updates current node
+        curr_Node = curr_Node->children.back();
+    }
+
+    // computes the counters of every folder
+    rebuildStats(root);
+
+    // adds every node to the size and time indexes
+    indexSubtree(root, true);
+
+    // sets current node to root
+    curr_Node = root;
+
+    // sets prev node to root
+    prev_Node = root;
+}
+
+// loads a compressed vfs.dat
+// -- every block holds whole top-level subtrees, so each block is decompressed and turned into nodes
+//    on its own thread, and the subtrees are attached to the root once every block is built
+void VFS::loadCompressed(ifstream &fin) {
+    DatReader reader;
+    reader.open(fin);
+
+    // the top-level nodes of every block, in order, and the root found in the first block
+    int count = reader.blockCount();
+    Vector<Node*>* tops = new Vector<Node*>[max(count, 1)];
+    DatRecord root_record;
+
+    try {
+        if (reader.splitsSubtrees()) {
+            parallelBlocks(count, [this, &reader, &root_record, tops](int i) {
+                loadBlocks(reader, i, i + 1, root_record, tops[i]);
+            });
+        }
+        // the first version may cut a subtree between blocks, so its blocks are read in order
+        else {
+            loadBlocks(reader, 0, count, root_record, tops[0]);
+        }
+
+        if (root_record.path != "/") {
+            throw runtime_error("Invalid compressed file");
+        }
+    }
+    catch (...) {
+        // deletes the subtrees built before the error
+        for (int i = 0; i < count; i++) {
+            for (int j = 0; j < tops[i].size(); j++) {
+                removeNode(tops[i][j]);
+            }
+        }
+        delete [] tops;
+        throw;
+    }
+
+    // stitches the subtrees under the root
+    root = new Node("/", nullptr, root_record.type, root_record.size, root_record.time_created);
+    root->inode->time_modified = root_record.time_modified;
+    root->inode->time_accessed = root_record.time_accessed;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < tops[i].size(); j++) {
+            attachChild(root, tops[i][j]);
+        }
+    }
+    delete [] tops;
+
+    compressed_dat = true;
+
+    // the subtrees have their counters already, so only the root is left
+    gatherStats(root);
+
+    // adds every node to the size and time indexes
+    indexSubtree(root, true);
+
+    // sets current and previous node to root
+    curr_Node = root;
+    prev_Node = root;
+}
+
+// turns the records of the blocks from first to last - 1 into nodes and computes their counters
+// -- the top-level nodes are appended to tops; the root, the first record of the file, is only
+//    copied into root_record, since the nodes of other blocks are attached to it afterwards
+void VFS::loadBlocks(DatReader &reader, int first, int last, DatRecord &root_record, Vector<Node*> &tops) {
+    // variables for one record and the nodes along its path, by depth, without the root
+    DatCursor at;
+    DatRecord record;
+    Vector<Node*> open;
+    int first_top = tops.size();
+
+    for (int i = first; i < last; i++) {
+        reader.decodeBlock(i);
+        reader.openBlock(i, at);
+
+        while (reader.next(at, record)) {
+            if (record.path == "/") {
+                if (i != 0 || !root_record.path.empty() || !tops.empty()) {
+                    throw runtime_error("Invalid compressed file");
+                }
+                root_record = record;
+                continue;
+            }
+
+            // the records are in preorder, so the parent is the open folder one level up
+            int depth = count(record.path.begin(), record.path.end(), '/');
+            while (open.size() >= depth) {
+                open.erase(open.size() - 1);
+            }
+
+            if (record.path[0] != '/' || open.size() != depth - 1) {
+                throw runtime_error("Invalid compressed file");
+            }
+
+            Node* ptr = new Node(record.path.substr(record.path.find_last_of('/') + 1), nullptr, record.type, record.size, record.time_created);
+            ptr->inode->time_modified = record.time_modified;
+            ptr->inode->time_accessed = record.time_accessed;
+
+            // a symbolic link holds the path stored after it
+            if (record.type == symbolic_link) {
+                ptr->inode->data.write(0, record.target.data(), record.target.size(), false);
+            }
+
+            if (depth == 1) {
+                tops.push_back(ptr);
+            }
+            else {
+                attachChild(open.back(), ptr);
+            }
+
+            open.push_back(ptr);
+        }
+
+        reader.dropBlock(i);
+    }
+
+    // computes the counters of every subtree built
+    for (int i = first_top; i < tops.size(); i++) {
+        rebuildStats(tops[i]);
+    }
+}
+
+// helper method to remove all children under a specific node
+void VFS::removeNode(Node* ptr) {
+    // a clone that was never expanded only has to leave its source
+    unshare(ptr);
+
+    // clones still sharing the children of ptr take their own copy first
+    while (ptr->cow_clones != nullptr) {
+        materialize(ptr->cow_clones->back());
+    }
+
+    // variable to hold number of children
+    int num_children =ptr->children.size();
+
+    // loops through the childre of ptr
+    // -- a snapshot folder only deletes its own children, not the ones it reads in place
+    for (int i = 0; i < num_children; i++) {
+        if (ptr->children[i]->parent == ptr) {
+            removeNode(ptr->children[i]);
+        }
+    }
+
+    // deletes node
+    endWatches(ptr);
+    delete ptr;
+}
+
+// copies a node, eagerly or as a copy-on-write clone
+Node* VFS::cloneNode(Node *ptr, Node *parent, bool cow) {
+    // a clone that was never expanded shares the node that owns the children
+    Node* source = ptr->readSource();
+
+    // creates the copy of the node with an inode of its own, so hard links are not carried over
+    // -- a copied file shares the pages of the source until either one is written; a copied folder
+    //    counts every name of a file the source counted once
+    Node* copy = new Node(ptr->name, parent, new Inode(*ptr->inode));
+    copy->inode->size += sharedBytes(ptr);
+
+    // checks if the copy only records its source
+    if (cow) {
+        // files and empty folders have no children to share
+        if (!source->children.empty()) {
+            copy->cow_source = source;
+
+            if (source->cow_clones == nullptr) {
+                source->cow_clones = new Vector<Node*>;
+            }
+            source->cow_clones->push_back(copy);
+            cow_pending.insert(uint64_t(uintptr_t(copy)), copy);
+        }
+    }
     else {
-        fout << getPath(ptr);
+        // copies every child of the source
+        for (int i = 0; i < source->children.size(); i++) {
+            attachChild(copy, cloneNode(source->children[i], copy, false));
+        }
+    }
+
+    return copy;
+}
+
+// expands one level of a copy-on-write clone
+void VFS::materialize(Node *ptr) {
+    // checks if ptr still shares the children of its source
+    if (ptr->cow_source == nullptr) {
+        return;
+    }
+
+    // keeps the source before detaching from it
+    Node* source = ptr->cow_source;
+    unshare(ptr);
+
+    // a snapshot folder that took the children slot by slot replaces the ones it reads in place
+    if (!ptr->children.empty()) {
+        for (int i = 0; i < ptr->children.size(); i++) {
+            if (ptr->children[i]->parent != ptr) {
+                placeClone(ptr, i);
+            }
+        }
+        return;
+    }
+
+    // each child becomes a clone that shares the matching child of the source
+    for (int i = 0; i < source->children.size(); i++) {
+        attachChild(ptr, cloneNode(source->children[i], ptr, true));
+    }
+
+    // children of a clone in the tree become visible to the indexes
+    // -- clones in the bin are indexed when recovered
+    if (isAttached(ptr)) {
+        for (int i = 0; i < ptr->children.size(); i++) {
+            indexNode(ptr->children[i], true);
+        }
+    }
+}
+
+// expands a clone in a snapshot by taking the children of its source slot by slot
+// -- the slots point at the children of the source until one of them changes, so only the nodes on the
+//    path of a change are ever copied; the clone stays with its source to be found again
+void VFS::shareSlots(Node *ptr) {
+    ptr->children = ptr->cow_source->children;
+    ptr->cow_epoch = ++cow_epoch;
+    cow_pending.erase(uint64_t(uintptr_t(ptr)), ptr);
+}
+
+// gives every snapshot folder still reading a node in place its own clone of the node
+// -- called before the node or anything under it changes, or before it leaves its folder
+void VFS::releaseNode(Node *ptr) {
+    if (ptr->parent == nullptr || ptr->parent->cow_clones == nullptr) {
+        return;
+    }
+
+    Vector<Node*>& clones = *ptr->parent->cow_clones;
+    for (int i = 0; i < clones.size(); i++) {
+        // only folders that took their slots after ptr was last released can read it
+        if (clones[i]->children.empty() || clones[i]->cow_epoch <= ptr->cow_epoch) {
+            continue;
+        }
+
+        // the slot of ptr is where the folder read it, unless a removal moved ptr since
+        Vector<Node*>& slots = clones[i]->children;
+        int slot = ptr->slot;
+        if (slot >= slots.size() || slots[slot] != ptr) {
+            for (slot = 0; slot < slots.size() && slots[slot] != ptr; slot++);
+        }
+
+        if (slot < slots.size()) {
+            placeClone(clones[i], slot);
+        }
+    }
+
+    ptr->cow_epoch = cow_epoch;
+}
+
+// replaces a slot a snapshot folder reads in place with its own clone of the node
+void VFS::placeClone(Node *ptr, int slot) {
+    Node* copy = cloneNode(ptr->children[slot], ptr, true);
+    copy->slot = slot;
+    ptr->children[slot] = copy;
+}
+
+// checks if a node belongs to a snapshot, rather than to the tree or the bin
+bool VFS::isFrozen(Node *ptr) {
+    for (; ptr->parent != nullptr; ptr = ptr->parent) {
+        // a removed node keeps its parent but no longer holds its slot
+        if (ptr->slot >= ptr->parent->children.size() || ptr->parent->children[ptr->slot] != ptr) {
+            return false;
+        }
+    }
+
+    return ptr != root;
+}
+
+// detaches a copy-on-write clone from its source
+void VFS::unshare(Node *ptr) {
+    // checks if ptr is a clone
+    if (ptr->cow_source == nullptr) {
+        return;
+    }
+
+    // removes ptr from the clones of its source
+    Vector<Node*>* clones = ptr->cow_source->cow_clones;
+    for (int i = 0; i < clones->size(); i++) {
+        if ((*clones)[i] == ptr) {
+            clones->erase(i);
+            break;
+        }
+    }
+
+    // deletes the list once no clone is left
+    if (clones->empty()) {
+        delete clones;
+        ptr->cow_source->cow_clones = nullptr;
+    }
+
+    ptr->cow_source = nullptr;
+    cow_pending.erase(uint64_t(uintptr_t(ptr)), ptr);
+}
+
+// expands clones sharing the path to a node about to change
+void VFS::prepareMutation(Node *ptr) {
+    // nothing is shared while every clone is expanded and no snapshot reads the tree in place
+    if (cow_pending.empty() && snapshots.empty()) {
+        return;
+    }
+
+    // collects ptr and its ancestors
+    Vector<Node*> path;
+    for (Node* curr = ptr; curr != nullptr; curr = curr->parent) {
+        path.push_back(curr);
+    }
+
+    // expands clones from the root down
+    // -- a clone in a snapshot takes the children slot by slot, a clone in the tree copies them; then the
+    //    next node on the path leaves the snapshot folders reading it, which clones it there
+    for (int i = path.size() - 1; i >= 0; i--) {
+        if (path[i]->cow_clones != nullptr) {
+            Vector<Node*> clones(*path[i]->cow_clones);
+            for (int j = 0; j < clones.size(); j++) {
+                if (!clones[j]->children.empty()) {
+                    continue;
+                }
+
+                if (isFrozen(clones[j])) {
+                    shareSlots(clones[j]);
+                }
+                else {
+                    materialize(clones[j]);
+                }
+            }
+        }
+
+        if (i > 0) {
+            releaseNode(path[i - 1]);
+        }
+    }
+
+    // ptr itself takes its own children if it is a clone
+    materialize(ptr);
+}
+
+// adds a child at the end of a folder and records its slot
+void VFS::attachChild(Node *parent, Node *child) {
+    child->parent = parent;
+    child->slot = parent->children.size();
+    child->cow_epoch = cow_epoch;
+    parent->children.push_back(child);
+
+    // the children of a large folder by name take the child at its place
+    if (parent->by_name != nullptr) {
+        NameKey key = {&child->name};
+        parent->by_name->insert(key, child);
+    }
+}
+
+// adds a child back into the slot it was detached from
+// -- the node that took over the slot moves back to the end, reversing detachChild
+void VFS::attachChildAt(Node *parent, Node *child, int slot) {
+    attachChild(parent, child);
+
+    if (slot < child->slot) {
+        Node* other = parent->children[slot];
+        parent->children[child->slot] = other;
+        other->slot = child->slot;
+
+        parent->children[slot] = child;
+        child->slot = slot;
+    }
+}
+
+// removes a child from its folder in constant time
+// -- the last child takes over the slot; the parent pointer is kept for the bin
+void VFS::detachChild(Node *child) {
+    // variables for the siblings and the last child
+    Vector<Node*>& siblings = child->parent->children;
+    Node* last = siblings.back();
+
+    // moves the last child into the freed slot
+    siblings[child->slot] = last;
+    last->slot = child->slot;
+
+    // drops the last position
+    siblings.erase(siblings.size() - 1);
+
+    // checks if the folder kept its children sorted by name
+    Node* parent = child->parent;
+    if (parent->by_name == nullptr) {
+        return;
+    }
+
+    // a folder that became small goes back to scanning its children
+    if (siblings.size() < NAME_INDEX_MIN / 2) {
+        delete parent->by_name;
+        parent->by_name = nullptr;
+        return;
+    }
+
+    NameKey key = {&child->name};
+    parent->by_name->erase(key, child);
+}
+
+// keeps the children of a folder by name once it holds NAME_INDEX_MIN of them
+// -- attachChild and detachChild keep them up to date from then on, in O(log n) each, so building
+//    them waits for the first lookup and loading a large folder does not insert into them one by one
+void VFS::sortNames(Node *ptr) {
+    if (ptr->by_name != nullptr || ptr->children.size() < NAME_INDEX_MIN) {
+        return;
+    }
+
+    ptr->by_name = new SkipList<NameKey, Node*>();
+    for (int i = 0; i < ptr->children.size(); i++) {
+        NameKey key = {&ptr->children[i]->name};
+        ptr->by_name->insert(key, ptr->children[i]);
+    }
+}
+
+// returns the first child of a folder by name whose name is not before name, nullptr if none
+SkipList<NameKey, Node*>::Entry* VFS::nameBound(Node *ptr, const string &name) {
+    NameKey key = {&name};
+    return ptr->by_name->lowerBound(key);
+}
+
+// returns the number of folders between a node and the root
+int VFS::getDepth(Node *ptr) {
+    int depth = 0;
+    for (Node* curr = ptr->parent; curr != nullptr; curr = curr->parent) {
+        depth++;
+    }
+    return depth;
+}
+
+// collects every folder under ptr up to depth levels, subfolders first
+void VFS::duEntries(Node *ptr, string path, int depth, Vector<PathEntry> &entries) {
+    // a clone broken down is expanded, as its copies count every name of a linked file while the
+    // folders it shares count each file once
+    if (depth > 0) {
+        materialize(ptr);
+    }
+    Node* source = ptr->readSource();
+
+    // breaks the folder down one level per remaining depth
+    if (depth > 0) {
+        for (int i = 0; i < source->children.size(); i++) {
+            Node* child = source->children[i];
+
+            if (child->inode->type == folder) {
+                duEntries(child, ((ptr == root) ? "" : path) + '/' + child->name, depth - 1, entries);
+            }
+        }
+    }
+
+    PathEntry entry = {ptr, path};
+    entries.push_back(entry);
+}
+
+// collects the k largest files under ptr, searching the folders with the largest files first
+// -- a folder is only expanded once its largest file could still make the list
+void VFS::topEntries(Node *ptr, int k, Vector<PathEntry> &entries) {
+    // nodes of the search and their paths
+    Vector<Node*> nodes;
+    Vector<string> paths;
+
+    // candidates ordered by the largest file they hold, holding indices into nodes
+    SkipList<uint64_t, int> frontier;
+
+    // starts from ptr
+    nodes.push_back(ptr);
+    paths.push_back((ptr == root) ? "" : getPath(ptr));
+    frontier.insert(ptr->inode->stats.max_file, 0);
+
+    int found = 0;
+    while (found < k && !frontier.empty()) {
+        // takes the candidate with the largest file
+        SkipList<uint64_t, int>::Entry* entry = frontier.last();
+        int id = entry->value;
+        frontier.erase(entry->key, id);
+
+        // a file is the next largest
+        if (nodes[id]->inode->type == file) {
+            PathEntry file_entry = {nodes[id], paths[id]};
+            entries.push_back(file_entry);
+            found++;
+            continue;
+        }
+
+        // reads the children through the source of a copy-on-write clone instead of expanding it
+        Node* source = nodes[id]->readSource();
+
+        // adds the children holding files as candidates
+        for (int i = 0; i < source->children.size(); i++) {
+            Node* child = source->children[i];
+
+            if (child->inode->stats.files > 0) {
+                nodes.push_back(child);
+                paths.push_back(paths[id] + '/' + child->name);
+                frontier.insert(child->inode->stats.max_file, nodes.size() - 1);
+            }
+        }
+    }
+}
+
+// adds or removes a node in the time index, and a file in the size index too
+void VFS::indexNode(Node *ptr, bool add) {
+    if (add) {
+        time_index.insert(ptr->inode->time_created, ptr);
+        if (ptr->inode->type == file) {
+            size_index.insert(ptr->inode->size, ptr);
+        }
+    }
+    else {
+        time_index.erase(ptr->inode->time_created, ptr);
+        if (ptr->inode->type == file) {
+            size_index.erase(ptr->inode->size, ptr);
+        }
+    }
+}
+
+// adds or removes every node of the expanded part of a subtree in the indexes
+void VFS::indexSubtree(Node *ptr, bool add) {
+    indexNode(ptr, add);
+
+    for (int i = 0; i < ptr->children.size(); i++) {
+        indexSubtree(ptr->children[i], add);
+    }
+}
+
+// checks a node against the size, time, type and name predicates of a query
+bool VFS::matchesQuery(const Node *ptr, const QueryFilter &filter) {
+    if (filter.type >= 0 && ptr->inode->type != filter.type) {
+        return false;
+    }
+
+    // a size range only matches files
+    if (filter.by_size && (ptr->inode->type != file || ptr->inode->size < filter.size_min || ptr->inode->size > filter.size_max)) {
+        return false;
+    }
+
+    if (filter.by_time && (ptr->inode->time_created < filter.time_min || ptr->inode->time_created > filter.time_max)) {
+        return false;
+    }
+
+    return filter.name.empty() || fnmatch(filter.name.c_str(), ptr->name.c_str(), 0) == 0;
+}
+
+// collects the matching nodes below a node at path, up to the limit of the query
+// -- the children of a copy-on-write clone are read through its source
+void VFS::queryWalk(const Node *ptr, string path, const QueryFilter &filter, Vector<PathEntry> &entries) {
+    const Node* source = ptr->readSource();
+
+    for (int i = 0; i < source->children.size(); i++) {
+        if (filter.limit > 0 && entries.size() >= filter.limit) {
+            return;
+        }
+
+        const Node* child = source->children[i];
+        string child_path = path + '/' + child->name;
+
+        if (matchesQuery(child, filter)) {
+            PathEntry found = {child, child_path};
+            entries.push_back(found);
+        }
+
+        queryWalk(child, child_path, filter, entries);
+    }
+}
+
+// checks if a node is a folder or lies in its subtree
+bool VFS::isUnder(Node *ptr, Node *folder) {
+    for (; ptr != nullptr; ptr = ptr->parent) {
+        if (ptr == folder) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// returns the highest node holding ptr: the root in the tree, the removed node in the bin
+Node* VFS::getTop(Node *ptr) {
+    for (; ptr->parent != nullptr; ptr = ptr->parent) {
+        // a removed node keeps its parent but no longer holds its slot
+        if (ptr->slot >= ptr->parent->children.size() || ptr->parent->children[ptr->slot] != ptr) {
+            break;
+        }
+    }
+
+    return ptr;
+}
+
+// checks if a node is reachable from the root, rather than held in the bin
+bool VFS::isAttached(Node *ptr) {
+    for (; ptr != root; ptr = ptr->parent) {
+        // a removed node keeps its parent but no longer holds its slot
+        if (ptr->parent == nullptr || ptr->slot >= ptr->parent->children.size() ||
+            ptr->parent->children[ptr->slot] != ptr) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// returns the deepest folder containing both nodes
+Node* VFS::getCommonAncestor(Node *first, Node *second) {
+    // variables for the depth of both nodes
+    int first_depth = getDepth(first);
+    int second_depth = getDepth(second);
+
+    // brings the deeper node up to the level of the other
+    for (; first_depth > second_depth; first_depth--) {
+        first = first->parent;
+    }
+    for (; second_depth > first_depth; second_depth--) {
+        second = second->parent;
+    }
+
+    // climbs both chains until they meet
+    while (first != second) {
+        first = first->parent;
+        second = second->parent;
+    }
+
+    return first;
+}
+
+// adds the size and counters of a subtree to the folders from first up to, not including, stop
+// -- the subtree is already a child of first
+void VFS::addStats(Node *first, Node *stop, Node *ptr) {
+    for (Node* curr = first; curr != stop; curr = curr->parent) {
+        curr->inode->size += ptr->inode->size;
+        curr->inode->stats.files += ptr->inode->stats.files;
+        curr->inode->stats.folders += ptr->inode->stats.folders;
+        curr->inode->stats.links += ptr->inode->stats.links;
     }
-    fout << "," << ptr->size << "," << ptr->type << "," << ptr->time_created;
 
-    // loops through the children of ptr
+    liftMax(first, 0, ptr->inode->stats.max_file);
+}
+
+// subtracts the size and counters of a detached subtree from the folders from first up to, not including, stop
+// -- the subtree was a child of first
+void VFS::subtractStats(Node *first, Node *stop, Node *ptr) {
+    for (Node* curr = first; curr != stop; curr = curr->parent) {
+        curr->inode->size -= ptr->inode->size;
+        curr->inode->stats.files -= ptr->inode->stats.files;
+        curr->inode->stats.folders -= ptr->inode->stats.folders;
+        curr->inode->stats.links -= ptr->inode->stats.links;
+    }
+
+    liftMax(first, ptr->inode->stats.max_file, 0);
+}
+
+// passes the largest file of a child of ptr, changed from old_max to new_max, up the folders above it
+// -- a folder counts the children holding its largest file, so it only looks at all its children
+//    once the last of them lost it; the climb stops at the first folder whose largest file stays
+void VFS::liftMax(Node *ptr, uint64_t old_max, uint64_t new_max) {
+    for (Node* curr = ptr; curr != nullptr; curr = curr->parent) {
+        Stats& stats = curr->inode->stats;
+        uint64_t before = stats.max_file;
+
+        if (new_max > before) {
+            stats.max_file = new_max;
+            stats.max_count = 1;
+        }
+        else if (new_max == before && before > 0 && old_max != before) {
+            stats.max_count++;
+        }
+        else if (old_max == before && before > 0 && new_max < old_max) {
+            if (--stats.max_count == 0) {
+                refreshLevel(curr);
+            }
+        }
+
+        if (stats.max_file == before) {
+            return;
+        }
+        old_max = before;
+        new_max = stats.max_file;
+
+        // a folder in the bin keeps its counters for recover but no longer adds to its old parent
+        Node* parent = curr->parent;
+        if (parent == nullptr || curr->slot >= parent->children.size() || parent->children[curr->slot] != curr) {
+            return;
+        }
+    }
+}
+
+// recomputes the largest file of a folder from its children, with the children holding it
+// -- returns true if the largest file changed
+bool VFS::refreshLevel(Node *ptr) {
+    // variables for the largest file over the children and how many hold it
+    uint64_t max_file = 0;
+    unsigned int max_count = 0;
+
     for (int i = 0; i < ptr->children.size(); i++) {
-        write(fout, ptr->children[i]);
+        uint64_t child_max = ptr->children[i]->inode->stats.max_file;
+        if (child_max > max_file) {
+            max_file = child_max;
+            max_count = 0;
+        }
+        if (child_max == max_file && max_file > 0) {
+            max_count++;
+        }
     }
+
+    bool changed = max_file != ptr->inode->stats.max_file;
+    ptr->inode->stats.max_file = max_file;
+    ptr->inode->stats.max_count = max_count;
+    return changed;
 }
 
-// helper method to load the vfs.dat
-void VFS::load(ifstream &fin) {
-    // variable to hold parameters
-    string params, curr_path;
+// computes the counters of every folder under ptr from the sizes of its files
+void VFS::rebuildStats(Node *ptr) {
+    for (int i = 0; i < ptr->children.size(); i++) {
+        rebuildStats(ptr->children[i]);
+    }
 
-    // array to hold various parameters of the node
-    // 0 - name
-    // 1 - size
-    // 2 - type
-    // 3 - time_created
-    string paramsArray[4];
+    gatherStats(ptr);
+}
 
-    // read parameters for root node
-    getline(fin, params);
+// computes the counters of a node from the counters of its children
+void VFS::gatherStats(Node *ptr) {
+    // counters of a file only describe the file itself
+    ptr->inode->stats = Stats(ptr->inode->type, ptr->inode->size);
 
-    // creates stringstream object of params
-    stringstream sstr(params);
+    for (int i = 0; i < ptr->children.size(); i++) {
+        Node* child = ptr->children[i];
 
-    // loops to get all params
-    for (int i = 0; !sstr.eof(); i++) {
-        getline(sstr, paramsArray[i], ',');
+        ptr->inode->stats.files += child->inode->stats.files;
+        ptr->inode->stats.folders += child->inode->stats.folders;
+        ptr->inode->stats.links += child->inode->stats.links;
     }
 
-    // sets current path to the root
-    curr_path = paramsArray[0];
+    // a folder also counts the children holding its largest file
+    if (ptr->inode->type == folder) {
+        refreshLevel(ptr);
+    }
+}
 
-    // creates the root node
-    root = new Node(paramsArray[0], nullptr, stoi(paramsArray[2]) ? folder : file, stoi(paramsArray[1]), paramsArray[3] + "\n");
+// resolves the folder that would hold a new node at the given path and the name of the node
+Node* VFS::getParentFolder(string path, string &name) {
+    // variable for the folder holding the node
+    Node* parent_node;
 
-    // makes current node root
-    curr_Node = root;
+    // the last part of the path names the node
+    size_t found = path.find_last_of('/');
 
-    // checks for the end of the file
-    while (getline(fin, params)) {
+    if (found == string::npos) {
+        parent_node = curr_Node;
+        name = path;
+    }
+    else {
+        parent_node = (found == 0) ? root : getNode(path.substr(0, found));
+        name = path.substr(found + 1);
+    }
 
-        // clears the sstr buffer
-        sstr.clear();
+    // checks if the folder exists
+    if (parent_node == nullptr || parent_node->inode->type != folder) {
+        throw runtime_error("Destination folder does not exist");
+    }
 
-        // creates stringstream object of params
-        sstr.str(params);
+    return parent_node;
+}
 
-        // loops to get all params
-        for (int i = 0; !sstr.eof(); i++) {
-            getline(sstr, paramsArray[i], ',');
+// adds a new file of size bytes to a folder, a hole until it is written
+Node* VFS::addFile(Node *parent, string name, uint64_t size) {
+    checkGrowth(parent, size, 1);
+
+    Node* newFile = new Node(name, parent, file, size, timestampNow());
+    addNode(parent, newFile);
+    return newFile;
+}
+
+// adds a new node to a folder, with the indexes and the counters of the folders above it
+void VFS::addNode(Node *parent, Node *ptr) {
+    // stops copies from sharing the folder being changed
+    prepareMutation(parent);
+
+    // adds to the children of the folder
+    attachChild(parent, ptr);
+    logUndo(undo_create, ptr, "");
+    parent->inode->time_modified = timestampNow();
+    notify(parent, ptr->name, ptr->inode->type, watch_created, 0);
+
+    // adds the node to the size and time indexes
+    indexNode(ptr, true);
+
+    // updates size and counters of the folder and its parents
+    chargeStats(parent, nullptr, ptr, true);
+    chargeLinks(parent, nullptr, ptr, true);
+}
+
+// collects every name of the inode of a node, ptr alone unless it has hard links
+void VFS::getNames(Node *ptr, Vector<Node*> &names) {
+    if (ptr->inode->names == nullptr) {
+        names.push_back(ptr);
+    }
+    else {
+        names = *ptr->inode->names;
+    }
+}
+
+// applies the queued counters of a transaction once the tree holds any linked file
+// -- a subtree is only searched for linked files when its count of them is current
+void VFS::settleLinks() {
+    if (root->inode->stats.links > 0 || queued_links > 0) {
+        settleStats();
+    }
+}
+
+// collects every name under ptr of a file with hard links, skipping the subtrees without any
+// -- a copy-on-write clone gives each name its own inode, so nothing under one is linked
+void VFS::linkedFiles(Node *ptr, Vector<Node*> &files) {
+    if (ptr->inode->stats.links == 0 || ptr->cow_source != nullptr) {
+        return;
+    }
+
+    if (ptr->inode->type != folder) {
+        if (ptr->inode->names != nullptr) {
+            files.push_back(ptr);
         }
+        return;
+    }
 
-        // searches for current path in read params
-        size_t found = paramsArray[0].find(curr_path);
+    for (int i = 0; i < ptr->children.size(); i++) {
+        linkedFiles(ptr->children[i], files);
+    }
+}
 
-        // finds common parent 
-        while (found == string::npos) {
-            // finds last instance of '/' and removes from current path
-            found = curr_path.find_last_of('/');
+// returns the deepest folder at or above folder holding a name of the file ptr outside skip, nullptr if none
+// -- only names under the same top count, as a removed folder in the bin keeps counters of its own
+Node* VFS::getLinkHolder(Node *folder, Node *ptr, Node *skip) {
+    Node* held = nullptr;
+    Node* top = getTop(folder);
+    Vector<Node*> names;
+    getNames(ptr, names);
 
-            if (found != curr_path.size() - 1) {
-                curr_Node = curr_Node->parent;
+    for (int i = 0; i < names.size(); i++) {
+        if (isUnder(names[i], skip) || getTop(names[i]) != top) {
+            continue;
+        }
+
+        Node* common = getCommonAncestor(folder, names[i]);
+        if (held == nullptr || getDepth(common) > getDepth(held)) {
+            held = common;
+        }
+    }
+
+    return held;
+}
+
+// returns the bytes the size of ptr leaves out by counting each hard-linked file under it once
+// -- a copy gives every name its own inode, so its size is the size of ptr plus these bytes
+uint64_t VFS::sharedBytes(Node *ptr) {
+    Vector<Node*> files;
+    linkedFiles(ptr, files);
+
+    // every name after the first of a file is left out
+    uint64_t bytes = 0;
+    for (int i = 0; i < files.size(); i++) {
+        for (int j = 0; j < i; j++) {
+            if (files[j]->inode == files[i]->inode) {
+                bytes += files[i]->inode->size;
+                break;
             }
+        }
+    }
 
-            // updates current path
-            curr_path = curr_path.replace(found, curr_path.size(), "");
-            
-            // updates current path if moved up one level
-            if (curr_path.empty()) {
-                curr_path = "/";
+    return bytes;
+}
+
+// takes the hard-linked files under ptr off the byte charge of every folder already holding another
+// name of them, when ptr is about to be added under the charged folders
+void VFS::discountLinks(Vector<QuotaCharge> &charges, Node *ptr) {
+    settleLinks();
+    if (ptr->inode->stats.links == 0) {
+        return;
+    }
+
+    Vector<Node*> files;
+    linkedFiles(ptr, files);
+
+    for (int i = 0; i < charges.size(); i++) {
+        // variables for the inodes already taken off this charge
+        Vector<Inode*> taken;
+
+        for (int j = 0; j < files.size(); j++) {
+            Inode* inode = files[j]->inode;
+            bool seen = false;
+            for (int k = 0; k < taken.size(); k++) {
+                seen = seen || taken[k] == inode;
             }
 
-            // searches for current path in read params
-            found = paramsArray[0].find(curr_path);
+            Node* held = getLinkHolder(charges[i].folder, files[j], ptr);
+            if (seen || held != charges[i].folder) {
+                continue;
+            }
 
-            if ((found != string::npos) && (curr_path.back() != '/')) {
-                curr_path += '/';
+            charges[i].bytes -= min(charges[i].bytes, inode->size);
+            taken.push_back(inode);
+        }
+    }
+}
+
+// expands clones sharing the path to any name of a file about to change
+// -- a clone still reading a hard link elsewhere would otherwise see the change
+void VFS::prepareInode(Node *ptr) {
+    Vector<Node*> names;
+    getNames(ptr, names);
+
+    for (int i = 0; i < names.size(); i++) {
+        prepareMutation(names[i]);
+    }
+}
+
+// returns the file at a path or child name, creating an empty one if create is set
+Node* VFS::getFile(string path, bool create) {
+    if (path.empty()) {
+        throw runtime_error("Invalid path");
+    }
+
+    Node* ptr = resolve(path);
+
+    if (ptr == nullptr) {
+        if (!create) {
+            throw runtime_error("File does not exist");
+        }
+
+        // the last part of the path names the new file
+        string name;
+        Node* parent = getParentFolder(path, name);
+
+        if (!isValid(name, file) || name.empty()) {
+            throw runtime_error("File name is not valid");
+        }
+
+        // the name may be taken by a symbolic link leading nowhere
+        if (!isUnique(name, parent)) {
+            throw runtime_error("Symbolic link leads nowhere");
+        }
+
+        return addFile(parent, name, 0);
+    }
+
+    if (ptr->inode->type != file) {
+        throw runtime_error("Not a file");
+    }
+
+    return ptr;
+}
+
+// changes the size of a file, with its counters, the size index and the folders above every name of it
+void VFS::resizeFile(Node *ptr, uint64_t size) {
+    if (size == ptr->inode->size) {
+        return;
+    }
+
+    // stand-in for the file as it was, taken off the ancestors once the new size is added to them
+    // -- a lowered maximum is then recomputed from the file as it is now
+    Node old_file("", nullptr, file, ptr->inode->size, 0);
+    old_file.inode->stats.links = ptr->inode->stats.links;
+    int64_t growth = int64_t(size) - int64_t(ptr->inode->size);
+
+    // variables for the names of the file and whether each is in the tree
+    Vector<Node*> names;
+    Vector<bool> attached;
+    getNames(ptr, names);
+
+    for (int i = 0; i < names.size(); i++) {
+        attached.push_back(isAttached(names[i]));
+        if (attached[i]) {
+            size_index.erase(ptr->inode->size, names[i]);
+        }
+    }
+
+    ptr->inode->size = size;
+    ptr->inode->stats.max_file = size;
+
+    // a name in the bin changes the removed folders above it, which recover adds back
+    // -- every name gains the new size before any loses the old one, since a recount of a folder
+    //    already sees all of them at the new size
+    for (int i = 0; i < names.size(); i++) {
+        if (attached[i]) {
+            size_index.insert(size, names[i]);
+        }
+
+        Node* top = getTop(names[i]);
+        if (names[i] != top) {
+            chargeStats(names[i]->parent, top->parent, names[i], true);
+        }
+    }
+    for (int i = 0; i < names.size(); i++) {
+        Node* top = getTop(names[i]);
+        if (names[i] != top) {
+            chargeStats(names[i]->parent, top->parent, &old_file, false);
+        }
+    }
+
+    // a folder above several names holds the file once, so it only changes through the first of them
+    for (int i = 1; i < names.size(); i++) {
+        Node* top = getTop(names[i]);
+        Node* held = nullptr;
+
+        for (int j = 0; j < i; j++) {
+            if (getTop(names[j]) == top) {
+                Node* common = getCommonAncestor(names[i], names[j]);
+                if (held == nullptr || getDepth(common) > getDepth(held)) {
+                    held = common;
+                }
             }
         }
 
+        if (held != nullptr) {
+            chargeBytes(held, top->parent, -growth);
+        }
+    }
+}
+
+// appends the runs read by every file under ptr, without expanding clones
+void VFS::collectRuns(Node *ptr, Vector<const ExtentRun*> &runs) {
+    ptr->inode->data.addRuns(runs);
 
-        // replace portion of current path with ""
-        paramsArray[0].replace(found, curr_path.size(), "");
+    // reads the children through the source of a copy-on-write clone
+    Node* source = ptr->readSource();
+    for (int i = 0; i < source->children.size(); i++) {
+        collectRuns(source->children[i], runs);
+    }
+}
 
-        // checks if the after replacement, path still contains '/' at the begin
-        if (!paramsArray[0].empty() && paramsArray[0][0] == '/') {
-            paramsArray[0].erase(paramsArray[0].begin());
+// returns the nearest tagged folder, one with a quota or a watch, at or above a node, nullptr if none
+// -- the answer is cached on every node on the way up until the tag epoch changes
+Node* VFS::getTaggedFolder(Node *ptr) {
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+
+    if (ptr->tag_epoch != tag_epoch) {
+        bool tagged = ptr->inode->quota != nullptr || ptr->inode->watches != nullptr;
+        ptr->tag_folder = tagged ? ptr : getTaggedFolder(ptr->parent);
+        ptr->tag_epoch = tag_epoch;
+    }
+
+    return ptr->tag_folder;
+}
+
+// adds growth to the charge of one folder, merging charges of the same folder
+void VFS::addCharge(Vector<QuotaCharge> &charges, Node *folder, uint64_t bytes, uint64_t nodes) {
+    for (int i = 0; i < charges.size(); i++) {
+        if (charges[i].folder == folder) {
+            charges[i].bytes = (bytes > UINT64_MAX - charges[i].bytes) ? UINT64_MAX : charges[i].bytes + bytes;
+            charges[i].nodes = (nodes > UINT64_MAX - charges[i].nodes) ? UINT64_MAX : charges[i].nodes + nodes;
+            return;
         }
+    }
 
-        // creates new node
-        prev_Node = new Node(paramsArray[0], curr_Node, stoi(paramsArray[2]) ? folder : file, stoi(paramsArray[1]), paramsArray[3] + "\n");
-        
-        // adds newNode to current node's children
-        curr_Node->children.push_back(prev_Node);
+    QuotaCharge charge = {folder, bytes, nodes};
+    charges.push_back(charge);
+}
 
-        // updates current path
-        curr_path = curr_path + paramsArray[0] + '/';
+// charges growth under a folder to every folder with a quota above it, stopping at stop
+void VFS::chargeQuotas(Vector<QuotaCharge> &charges, Node *folder, Node *stop, uint64_t bytes, uint64_t nodes) {
+    for (Node* curr = getTaggedFolder(folder); curr != nullptr && curr != stop; curr = getTaggedFolder(curr->parent)) {
+        if (curr->inode->quota != nullptr) {
+            addCharge(charges, curr, bytes, nodes);
+        }
+    }
+}
 
-        // updates current node
-        curr_Node = curr_Node->children.back();
+// throws if a charged folder would pass its quota, or its totals would overflow
+void VFS::checkCharges(Vector<QuotaCharge> &charges) {
+    // a transaction queues its counters, so they are applied first when a quota is checked or the
+    // totals may come near overflowing
+    if (!unsettled.empty()) {
+        for (int i = 0; i < charges.size(); i++) {
+            // room left in the totals of the folder
+            Inode* inode = charges[i].folder->inode;
+            uint64_t bytes_room = UINT64_MAX - inode->size;
+            uint64_t nodes_room = UINT_MAX - max(inode->stats.files, inode->stats.folders);
+
+            if (inode->quota != nullptr ||
+                queued_bytes >= bytes_room || charges[i].bytes > bytes_room - queued_bytes ||
+                queued_nodes >= nodes_room || charges[i].nodes > nodes_room - queued_nodes) {
+                settleStats();
+                break;
+            }
+        }
     }
 
-    // sets current node to root
-    curr_Node = root;
+    for (int i = 0; i < charges.size(); i++) {
+        Node* ptr = charges[i].folder;
+        uint64_t size = ptr->inode->size;
+        uint64_t used = uint64_t(ptr->inode->stats.files) + ptr->inode->stats.folders - 1;
 
-    // sets prev node to root
-    prev_Node = root;
+        // the counters of files and folders are 32 bits each
+        if (charges[i].bytes > UINT64_MAX - size) {
+            throw runtime_error("Size is too large");
+        }
+        if (charges[i].nodes > UINT_MAX - max(ptr->inode->stats.files, ptr->inode->stats.folders)) {
+            throw runtime_error("Too many files and folders");
+        }
+
+        // only growth is checked, so a folder over its quota can still shrink
+        Quota* limits = ptr->inode->quota;
+        if (limits == nullptr) {
+            continue;
+        }
+        if (limits->bytes > 0 && charges[i].bytes > 0 && (size > limits->bytes || charges[i].bytes > limits->bytes - size)) {
+            throw runtime_error("Byte quota of " + getPath(ptr) + " exceeded");
+        }
+        if (limits->nodes > 0 && charges[i].nodes > 0 && (used > limits->nodes || charges[i].nodes > limits->nodes - used)) {
+            throw runtime_error("Node quota of " + getPath(ptr) + " exceeded");
+        }
+    }
 }
 
-// helper method to remove all children under a specific node
-void VFS::removeNode(Node* ptr) {
-    // variable to hold number of children
-    int num_children =ptr->children.size();
+// throws if adding bytes and nodes under a folder in the tree passes a quota above it
+// -- every total in the tree is at most the root's, so checking the root keeps them all from overflowing
+void VFS::checkGrowth(Node *folder, uint64_t bytes, uint64_t nodes) {
+    Vector<QuotaCharge> charges;
+    chargeQuotas(charges, folder, nullptr, bytes, nodes);
+    addCharge(charges, root, bytes, nodes);
+    checkCharges(charges);
+}
 
-    // loops through the childre of ptr
-    for (int i = 0; i < num_children; i++) {
-        removeNode(ptr->children[i]);
+// throws if a file cannot grow to size under every name it has
+// -- a folder above several names grows once per name; a name in the bin only grows the removed
+//    folders above it, whose growth recover checks against the quotas above them
+void VFS::checkResize(Node *ptr, uint64_t size) {
+    if (size <= ptr->inode->size) {
+        return;
     }
 
-    // deletes node
-    delete ptr;
-}
\ No newline at end of file
+    // variables for the growth and the names of the file
+    uint64_t growth = size - ptr->inode->size;
+    Vector<Node*> names;
+    getNames(ptr, names);
+
+    Vector<QuotaCharge> charges;
+    for (int i = 0; i < names.size(); i++) {
+        // the quotas above a removed folder wait for recover
+        Node* top = getTop(names[i]);
+        chargeQuotas(charges, names[i]->parent, getTaggedFolder(top->parent), growth, 0);
+        addCharge(charges, top, growth, 0);
+    }
+
+    checkCharges(charges);
+}
+
+// returns the index of the watch with the given id, -1 if there is none
+int VFS::findWatch(int id) {
+    for (int i = 0; i < watches.size(); i++) {
+        if (watches[i]->id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// sends an event about the node named name in a folder to the watches on the folder and to the
+// recursive watches above it
+// -- the tagged folders are climbed from the cache, and the path from each watched folder grows by
+//    the folders passed on the way
+void VFS::notify(Node *parent, const string &name, NodeType type, WatchType kind, uint32_t cookie) {
+    // mutations pay one test while nothing is watched
+    if (watches.empty()) {
+        return;
+    }
+
+    WatchEvent event = {kind, type, name, cookie, 1};
+    Node* curr = parent;
+    for (Node* tagged = getTaggedFolder(parent); tagged != nullptr; tagged = getTaggedFolder(tagged->parent)) {
+        for (; curr != tagged; curr = curr->parent) {
+            event.path = curr->name + '/' + event.path;
+        }
+
+        // a folder may be tagged for a quota alone
+        if (tagged->inode->watches == nullptr) {
+            continue;
+        }
+
+        Vector<Watch*> &list = *tagged->inode->watches;
+        for (int i = 0; i < list.size(); i++) {
+            if (list[i]->recursive || tagged == parent) {
+                deliver(list[i], event);
+            }
+        }
+    }
+}
+
+// puts a watch on a folder, tagging it
+void VFS::attachWatch(Watch *watch, Node *ptr) {
+    if (ptr->inode->watches == nullptr) {
+        ptr->inode->watches = new Vector<Watch*>;
+    }
+    ptr->inode->watches->push_back(watch);
+    watch->folder = ptr;
+}
+
+// takes a watch off its folder, which stays tagged while it has another watch
+void VFS::detachWatch(Watch *watch) {
+    Vector<Watch*>* list = watch->folder->inode->watches;
+    for (int i = 0; i < list->size(); i++) {
+        if ((*list)[i] == watch) {
+            list->erase(i);
+            break;
+        }
+    }
+
+    if (list->empty()) {
+        delete list;
+        watch->folder->inode->watches = nullptr;
+    }
+    watch->folder = nullptr;
+}
+
+// sends a modified event for every name of a file in the tree
+// -- repeated writes to a file merge into the event still waiting in each ring
+void VFS::notifyModified(Node *ptr) {
+    if (watches.empty()) {
+        return;
+    }
+
+    Vector<Node*> names;
+    getNames(ptr, names);
+    for (int i = 0; i < names.size(); i++) {
+        if (isAttached(names[i])) {
+            notify(names[i]->parent, names[i]->name, file, watch_modified, 0);
+        }
+    }
+}
+
+// sends an event to a watch, or holds it until the open transaction commits
+void VFS::deliver(Watch *watch, const WatchEvent &event) {
+    if (in_transaction) {
+        StagedEvent held = {watch, event};
+        staged.push_back(held);
+        return;
+    }
+
+    watch->ring.push(event);
+}
+
+// ends the watches of a folder about to be deleted
+// -- the watch keeps its events, the last one saying it ended, until it is dropped
+void VFS::endWatches(Node *ptr) {
+    if (ptr->inode->watches == nullptr) {
+        return;
+    }
+
+    Vector<Watch*> &list = *ptr->inode->watches;
+    for (int i = 0; i < list.size(); i++) {
+        WatchEvent ended = {watch_ended, folder, "", 0, 1};
+        list[i]->ring.push(ended);
+        list[i]->folder = nullptr;
+    }
+
+    delete ptr->inode->watches;
+    ptr->inode->watches = nullptr;
+    tag_epoch++;
+}
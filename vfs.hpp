@@ -9,11 +9,170 @@
 #include<ctime>
 #include<sstream>
 #include<fstream>
+#include<algorithm>
+#include<fnmatch.h>
 #include "node.hpp"
 #include "queue.hpp"
+#include "skiplist.hpp"
+#include "treediff.hpp"
+#include "datfile.hpp"
+#include "timestamp.hpp"
+#include "watch.hpp"
 
 using namespace std;
 
+// number of nodes read per batch from a listing
+const int LIST_BATCH = 256;
+
+// position of a streaming listing over the children of a folder
+struct ListCursor {
+	Node *folder;			//folder being listed
+	int position;			//index of the next child to visit
+	string prefix;			//only children starting with prefix are returned
+	bool by_name;			//the children are read by name, from next_name on
+	string next_name;		//smallest name the next child read by name can have
+};
+
+// children a folder needs before they are also kept by name in a skip list; the skip list is
+// dropped again once the folder shrinks below half of it
+const int NAME_INDEX_MIN = 64;
+
+// listing of the children of a folder returned by ls
+// -- unsorted listings read the children in place, sorted ones hold the matching nodes in order
+struct Listing {
+	ListCursor cursor;		//position over the children of the folder
+	Vector<Node*> sorted;	//matching children by decreasing size, for sorted listings
+	int position;			//index of the next sorted child
+	int remaining;			//entries left before the limit, -1 without one
+	bool is_sorted;			//the entries are read from sorted
+};
+
+// most symbolic links followed while resolving one path, so a loop of links ends
+const int SYMLINK_HOPS = 40;
+
+// longest path a symbolic link can hold
+const int SYMLINK_BYTES = 4096;
+
+// number of spans read per batch from the content of a file
+const int READ_BATCH = 64;
+
+// position of a streaming read over the content of a file
+// -- the spans point into the file and stay valid until it changes
+struct ReadCursor {
+	Node *file;				//file being read
+	uint64_t offset;		//offset of the next byte to read
+	uint64_t end;			//offset just past the last byte to read
+};
+
+// node returned by a query together with its path
+struct PathEntry {
+	const Node *node;		//node found by the query
+	string path;			//path of the node
+};
+
+// predicates of a query, every range inclusive
+// -- a size range only matches files, whose size is their content rather than a total
+struct QueryFilter {
+	bool by_size;			//only files with a size in the range are matched
+	uint64_t size_min;		//smallest size matched
+	uint64_t size_max;		//largest size matched
+	bool by_time;			//only nodes created in the range are matched
+	uint64_t time_min;		//earliest creation time matched, in nanoseconds
+	uint64_t time_max;		//latest creation time matched, in nanoseconds
+	string name;			//glob the name has to match, empty for any name
+	int type;				//file or folder matched, -1 for both
+	int limit;				//most nodes returned, -1 without a limit
+};
+
+// growth a change brings under one folder it is checked against
+struct QuotaCharge {
+	Node *folder;			//folder with a quota, or the top of a tree checked for overflow
+	uint64_t bytes;			//bytes the change adds under the folder
+	uint64_t nodes;			//files and folders the change adds under the folder
+};
+
+// event of an open transaction, sent to its watch at commit
+struct StagedEvent {
+	Watch *watch;			//watch the event goes to
+	WatchEvent event;		//the event
+};
+
+// working folders of one client, kept as paths so they survive removals
+struct Session {
+	string curr;			//path of the current folder
+	string prev;			//path of the previous folder
+	int id;					//client the session belongs to, 0 for the only user of a tree
+};
+
+// copy of one child returned by listEntries
+struct Entry {
+	string name;			//name of the node
+	NodeType type;			//type of the node
+	uint64_t size;			//size of the node
+	uint64_t time_created;	//creation time of the node, in nanoseconds
+	uint64_t time_modified;	//modification time of the node, in nanoseconds
+	uint64_t time_accessed;	//access time of the node, in nanoseconds
+};
+
+// kinds of mutation an open transaction can roll back
+enum UndoType {
+	undo_create,			//mkdir, touch or cp added the node
+	undo_remove,			//rm moved the node to the bin
+	undo_move,				//mv moved or renamed the node
+	undo_recover,			//recover took the node out of the bin
+	undo_write,				//write, append or truncate changed the content of the file
+	undo_quota,				//quota changed the limits of the folder
+	undo_skip,				//recover moved a node it could not put back to the end of the bin
+	undo_link,				//ln gave the file its first hard link
+};
+
+// what one mutation changed, enough to reverse it
+struct UndoRecord {
+	UndoType type;			//kind of mutation
+	Node *node;				//node the mutation applied to
+	Node *parent;			//folder holding the node before the mutation
+	int slot;				//slot of the node in that folder
+	string name;			//name of the node before the mutation
+	string path;			//bin path of a recovered node
+	FileData data;			//content of a written file before the mutation
+	uint64_t size;			//size of a written file before the mutation
+	Quota limits;			//limits of a folder before the mutation, 0 for none
+};
+
+// counters of a folder changed by an open transaction
+// -- the changes are queued and applied to every folder once, deepest first, when the counters are read
+struct DirtyFolder {
+	Node *node;				//folder whose counters changed
+	uint64_t size;			//size of the folder when the transaction first changed it
+	Stats stats;			//counters of the folder when the transaction first changed it
+	int64_t size_delta;		//size added by changes not applied yet
+	int64_t files_delta;	//files added by changes not applied yet
+	int64_t folders_delta;	//folders added by changes not applied yet
+	int64_t links_delta;	//names of hard-linked files added by changes not applied yet
+	uint64_t grown_max;		//largest file added by changes not applied yet
+	bool shrunk;			//a subtree left, so the largest file is recomputed from the children
+	bool queued;			//has changes not applied yet
+};
+
+// named point-in-time copy of the tree
+// -- the root is a copy-on-write clone, so a snapshot shares every folder the tree has not changed since
+struct Snapshot {
+	string name;			//name given at creation
+	Node *root;				//root of the copy, outside the tree
+	uint64_t time_created;	//time the snapshot was taken, in nanoseconds
+};
+
+// one difference between two versions of the tree
+struct DiffEntry {
+	char change;			//'+' added, '-' removed, '~' file or type changed
+	string path;			//path of the node
+};
+
+// state of a resumable walk over a subtree
+struct Walk {
+	Vector<Node*> stack;	//nodes left to visit
+};
+
 class VFS
 {
 	private:
@@ -22,40 +181,187 @@ class VFS
 		Node *prev_Node;			//previous Node
 		Queue<Node*> bin;			//bin containing the deleted Nodes
 		Queue<string> bin_paths;	//paths of the items in bin
+		SkipList<uint64_t, Node*> size_index;	//files in the tree ordered by size
+		SkipList<uint64_t, Node*> time_index;	//nodes in the tree ordered by creation time
+		SkipList<uint64_t, Node*> cow_pending;	//copy-on-write clones not yet expanded, by address
+		int open_walks;				//walks holding nodes on their stack
+		bool in_transaction;		//mutations are logged and their counters deferred
+		int session_id;				//id of the session the working folders belong to
+		int transaction_owner;		//id of the session that began the open transaction
+		Vector<UndoRecord> undo_log;	//mutations of the open transaction, oldest first
+		Vector<DirtyFolder> dirty;	//folders whose counters the open transaction changed
+		Vector<int> unsettled;		//indices of dirty folders with changes not applied yet
+		Vector<Snapshot> snapshots;	//named copies of the tree, oldest first
+		bool compressed_dat;		//the last file loaded or saved was compressed, so exit saves vfs.dat compressed
+		bool dedup;					//written bytes are chunked and shared through the chunk store
+		uint64_t tag_epoch;			//changes when a quota or a watch is set or nodes move, so cached tagged folders are found again
+		uint64_t cow_epoch;			//counts the snapshot folders that took their children slot by slot
+		uint64_t queued_bytes;		//bytes at least the queued counters of the open transaction add
+		uint64_t queued_nodes;		//files and folders at least the queued counters of the open transaction add
+		uint64_t queued_links;		//names of linked files the queued counters of the open transaction add
+		Vector<Watch*> watches;		//every watch by age, ended ones until they are dropped
+		int next_watch;				//id of the next watch
+		uint32_t next_cookie;		//cookie of the last move, 0 before any
+		Vector<StagedEvent> staged;	//events of the open transaction, sent at commit
 	
 	public:	 	
 		//Required methods
 		VFS();	
         ~VFS();   
-		void help();						
 		string pwd();
-		void ls(string sort_param);						
+		Listing ls(string params);
+		int nextEntries(Listing &listing, Node **batch, int max);	//reads the next entries of a listing
 		void mkdir(string folder_name);
-		void touch(string file_name, unsigned int size);
+		void touch(string file_name, uint64_t size);
 		void cd(string path);
 		void rm(string file_name);
-        void find(string name);
+        Vector<PathEntry> find(string name);
         void mv(string file, string folder);
+        void cp(string src, string dst, bool recursive, bool cow);
         void recover();
-		void size(string path);
-		void showbin();
+		void ln(string target, string link, bool symbolic);	//creates a hard link to a file, or a symbolic link holding a path
+		string readlink(string path);		//returns the path held by a symbolic link
+		uint64_t size(string path);
+		uint64_t physicalSize(string path);	//returns the bytes of pages held by the files under a node, shared pages once
+		Vector<PathEntry> du(string params);
+		Vector<PathEntry> top(string params);
+		Vector<PathEntry> query(string params);	//returns the nodes under a folder matching size, time, name and type predicates
+		Vector<PathEntry> quota(string params);	//sets the limits of a folder and returns the quotas applying to it
+		int watch(string params);			//watches the changes in a folder, or below it, and returns the id of the watch
+		void unwatch(int id);				//drops a watch and its events
+		void unwatchSession(int id);		//drops every watch a session set
+		WatchRing* watchRing(int id);		//returns the events of a watch, valid until it is dropped
+		PathEntry showbin();
 		void emptybin();
 		void exit();
+		void save(string filename, bool compressed);	//writes the tree to a file, compressed or as text
+		void begin();						//opens a transaction
+		void commit();						//applies the counters of the open transaction and keeps its changes
+		void abort();						//rolls back every change of the open transaction
+		bool inTransaction();				//returns true while a transaction is open
+		int transactionOwner();				//returns the id of the session that began the open transaction
+		void snapshotCreate(string name);	//records the tree under a name
+		const Vector<Snapshot>& snapshotList();	//returns the snapshots, oldest first
+		Vector<DiffEntry> snapshotDiff(string from, string to);	//compares two snapshots, or a snapshot and the tree if to is empty
+		void snapshotRestore(string name);	//replaces the tree with a snapshot
+		void snapshotDelete(string name);	//drops a snapshot
+		Vector<TreeChange> diff(string filename);	//compares the tree with a tree file
+		int sync(string filename);			//changes the tree to match a tree file, returns the number of mutations
+		void write(string path, uint64_t offset, const string &bytes);	//writes bytes into a file, creating it if needed
+		void append(string path, const string &bytes);	//writes bytes at the end of a file, creating it if needed
+		void overwrite(string path, const string &bytes);	//makes bytes the whole content of a file, creating it if needed
+		void truncate(string path, uint64_t size);	//cuts a file down or grows it with a hole
+		ReadCursor cat(string params);		//opens a read of the content of a file
+		int nextSpans(ReadCursor &cursor, iovec *batch, int max);	//points batch at the next bytes of a read
+		void setDedup(bool on);				//turns deduplication of written bytes on or off
+		bool getDedup();					//returns true if written bytes are deduplicated
+		Session getSession();				//returns the working folders as paths
+		void setSession(Session session);	//switches to the working folders of a session
+
+		// ---------------- Data methods -------------------------
+		Node* resolve(string path, bool follow = true);		// returns the node at a path or child name, the current folder if empty
+		void listEntries(string path, Vector<Entry> &entries); // copies the children of a folder
+		void completeNames(string path, Vector<string> &names); // collects the paths completing the last name of a path
+
+		// ---------------- Resumable walks -------------------------
+		void openWalk(Walk &walk, string path);				// opens a walk from the node at path
+		void closeWalk(Walk &walk);							// closes a walk, finished or not
+		bool walksOpen();									// returns true while a walk is open
+		bool findStep(Walk &walk, string name, Vector<string> &paths, int budget); // finds matching names in the next nodes
+		bool writeStep(Walk &walk, ofstream &fout, int budget);	// writes the next nodes in the vfs.dat format
+		void takeBin(Walk &walk);							// moves the bin into a walk for removeStep
+		bool removeStep(Walk &walk, int budget);			// deletes the next nodes taken from the bin
+		void leaveNode(Node *ptr);							// moves the working folders out of a node about to be deleted
 
         // ---------------- Helper methods -------------------------
-        string getTime();                           // returns system time as a string
         string getPath(Node* ptr);                  // returns the path of the current node
         bool isValid(string name, NodeType type);   // checks if file or folder name is valid
         bool isUnique(string name, Node* curr_dir); // checks if file or folder name is unique
 		bool find_helper(Node *ptr, string name);	// recursive method to check if a given child is present under specific Node or not
         Node* getChild(Node *ptr, string childname);// returns a specific child of given Node
-        void updateSize(Node *ptr);                 // re-calculates the size of a Node and its parents
-		void getMatchingNode(Node *ptr, string name, Queue<Node*>& matching_nodes); // populates a queue with matching nodes
-        Node* getNode(string path);					// Helper method to get a pointer to Node at given path
-		void bubbleSort(Vector<Node*>& container); 	// sorts a vector of node pointers
+		void getMatchingNode(Node *ptr, string path, string name, Vector<PathEntry>& matching_nodes); // populates a vector with matching nodes
+        Node* getNode(string path, bool follow = true); // Helper method to get a pointer to Node at given path
+        Node* walkPath(Node *ptr, const string &path, bool follow, int &hops); // returns the node at a path read from a folder
+        Node* followLink(Node *ptr, int &hops);     // returns the node a symbolic link leads to
+        string readLink(Node *ptr);                 // returns the path held by a symbolic link
+		void mergeSort(Vector<Node*>& container, bool by_name = false); // sorts node pointers by decreasing size or by name
+        ListCursor openList(Node *ptr, string prefix, int offset); // opens a cursor over the children of a folder
+        int nextBatch(ListCursor &cursor, Node **batch, int max);  // fills a batch of children from a cursor
 		void write(ofstream &fout, Node *ptr);		// traverse and write recrusively the vfs data
+		void writeLine(ofstream &fout, Node *ptr);	// writes the line describing one node
+		void writeRecords(DatWriter &writer, Node *ptr, const string &path); // adds a subtree to a compressed file
 		void load(ifstream &fin);					// Helper method to load the vfs.dat
+		void loadCompressed(ifstream &fin);			// loads a compressed vfs.dat, one block per thread
+		void loadBlocks(DatReader &reader, int first, int last, DatRecord &root_record, Vector<Node*> &tops); // builds the nodes of a range of blocks
 		void removeNode(Node *ptr);					// helper method to remove all children under a specific node
+        Node* cloneNode(Node *ptr, Node *parent, bool cow); // copies a node, eagerly or as a copy-on-write clone
+        void materialize(Node *ptr);                // expands one level of a copy-on-write clone
+        void unshare(Node *ptr);                    // detaches a copy-on-write clone from its source
+        void prepareMutation(Node *ptr);            // expands clones sharing the path to a node about to change
+        void shareSlots(Node *ptr);                 // expands a clone in a snapshot by taking the children of its source slot by slot
+        void releaseNode(Node *ptr);                // gives the snapshot folders reading a node in place their own clone of it
+        void placeClone(Node *ptr, int slot);       // replaces a slot a snapshot folder reads in place with a clone
+        bool isFrozen(Node *ptr);                   // checks if a node belongs to a snapshot
+        void attachChild(Node *parent, Node *child);// adds a child to a folder and records its slot
+        void attachChildAt(Node *parent, Node *child, int slot); // adds a child back into the slot it was detached from
+        void detachChild(Node *child);              // removes a child from its folder in constant time
+        void sortNames(Node *ptr);                  // keeps the children of a large folder sorted by name
+        SkipList<NameKey, Node*>::Entry* nameBound(Node *ptr, const string &name); // returns the first child by name not before name
+        int getDepth(Node *ptr);                    // returns the number of folders above a node
+        Node* getCommonAncestor(Node *first, Node *second); // returns the deepest folder containing both nodes
+        void addStats(Node *first, Node *stop, Node *ptr);      // adds the size and counters of a subtree to a chain of folders
+        void subtractStats(Node *first, Node *stop, Node *ptr); // subtracts the size and counters of a subtree from a chain of folders
+        void chargeStats(Node *first, Node *stop, Node *ptr, bool add); // updates a chain of folders now, or queues it in a transaction
+        void chargeBytes(Node *first, Node *stop, int64_t bytes); // adds bytes to the sizes of the folders from first up to stop
+        void chargeLinks(Node *first, Node *stop, Node *ptr, bool add); // corrects the charged sizes for the linked files under ptr
+        int markDirty(Node *ptr);                   // returns the dirty entry of a folder, adding it if needed
+        void settleStats();                         // applies the queued counters of the open transaction
+        void checkOwner();                          // throws if another session has a transaction open
+        void logUndo(UndoType type, Node *ptr, string path); // records how to reverse a mutation in a transaction
+        void skipBin();                             // moves the oldest node of the bin behind the newest one
+        void undo(UndoRecord &record);              // reverses one mutation
+        void flatten(Node *ptr, int parent, Vector<DatEntry> &entries); // appends a subtree to a flattened tree in preorder
+        int findSnapshot(string name);              // returns the index of a snapshot, -1 if missing
+        void diffNodes(Node *from, Node *to, string path, Vector<DiffEntry> &changes); // compares two versions of a folder
+        bool refreshLevel(Node *ptr);               // recomputes the largest file of a folder from its children
+        void liftMax(Node *ptr, uint64_t old_max, uint64_t new_max); // passes a changed largest file of a child up the folders above it
+        void rebuildStats(Node *ptr);               // computes the counters of a whole subtree
+        void gatherStats(Node *ptr);                // computes the counters of a node from those of its children
+        void duEntries(Node *ptr, string path, int depth, Vector<PathEntry> &entries); // collects the du folders of a subtree
+        void topEntries(Node *ptr, int k, Vector<PathEntry> &entries); // collects the k largest files under a node
+        void indexNode(Node *ptr, bool add);        // adds or removes one node in the size and time indexes
+        void indexSubtree(Node *ptr, bool add);     // adds or removes the nodes of a subtree in the size and time indexes
+        bool matchesQuery(const Node *ptr, const QueryFilter &filter); // checks a node against every predicate of a query
+        void queryWalk(const Node *ptr, string path, const QueryFilter &filter, Vector<PathEntry> &entries); // collects the matching nodes below a node by walking it
+        Node* getTop(Node *ptr);                    // returns the root, or the removed node holding ptr in the bin
+        bool isAttached(Node *ptr);                 // checks if a node is reachable from the root
+        bool isUnder(Node *ptr, Node *folder);      // checks if a node is a folder or lies in its subtree
+        Node* getParentFolder(string path, string &name); // resolves the folder and name for a new node at path
+        Node* addFile(Node *parent, string name, uint64_t size); // adds a new file to a folder
+        void addNode(Node *parent, Node *ptr);      // adds a new node to a folder, its indexes and counters
+        void getNames(Node *ptr, Vector<Node*> &names); // collects every hard link to the inode of a node
+        void prepareInode(Node *ptr);               // expands clones sharing the folders above any name of a file
+        void settleLinks();                         // applies the queued counters once the tree holds any linked file
+        void linkedFiles(Node *ptr, Vector<Node*> &files); // collects every name under ptr of a file with hard links
+        Node* getLinkHolder(Node *folder, Node *ptr, Node *skip); // returns the deepest folder above folder holding another name of a file
+        uint64_t sharedBytes(Node *ptr);            // returns the bytes ptr leaves out by counting each linked file once
+        void discountLinks(Vector<QuotaCharge> &charges, Node *ptr); // takes linked files already held off the charges of adding ptr
+        Node* getFile(string path, bool create);    // returns the file at path, creating an empty one if asked
+        void resizeFile(Node *ptr, uint64_t size);  // changes the size of a file and the counters above it
+        void collectRuns(Node *ptr, Vector<const ExtentRun*> &runs); // appends the runs read by the files of a subtree
+        Node* getTaggedFolder(Node *ptr);           // returns the nearest folder with a quota or a watch at or above a node
+        void addCharge(Vector<QuotaCharge> &charges, Node *folder, uint64_t bytes, uint64_t nodes); // adds growth to the charge of one folder
+        void chargeQuotas(Vector<QuotaCharge> &charges, Node *folder, Node *stop, uint64_t bytes, uint64_t nodes); // charges growth to the quotas above a folder, up to stop
+        void checkCharges(Vector<QuotaCharge> &charges); // throws if a charged folder would pass its quota or overflow
+        void checkGrowth(Node *folder, uint64_t bytes, uint64_t nodes); // throws if growth under an attached folder is not allowed
+        void checkResize(Node *ptr, uint64_t size); // throws if a file cannot grow to size under every name
+        int findWatch(int id);                      // returns the index of a watch, -1 if missing
+        void notify(Node *parent, const string &name, NodeType type, WatchType kind, uint32_t cookie); // sends an event to the watches on and above a folder
+        void attachWatch(Watch *watch, Node *ptr);  // puts a watch on a folder
+        void detachWatch(Watch *watch);             // takes a watch off its folder
+        void notifyModified(Node *ptr);             // sends a modified event for every name of a file in the tree
+        void deliver(Watch *watch, const WatchEvent &event); // sends an event to one watch, or stages it in a transaction
+        void endWatches(Node *ptr);                 // ends the watches of a folder about to be deleted
 };
 //===========================================================
 #endif
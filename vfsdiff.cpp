@@ -0,0 +1,107 @@
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<chrono>
+#include<stdlib.h>
+#include "treediff.hpp"
+using namespace std;
+
+// ---------------- vfsdiff: compares two vfs.dat files -------------------------
+// prints what was added, removed, resized or moved from the old tree to the new one, or with
+// --sync the vfs commands that turn the old tree into the new one
+//
+// usage: vfsdiff [--sync] <old> <new>
+
+// reads and hashes the tree in a file, returns false if it cannot be opened
+bool loadTree(const string &path, Vector<DatEntry> &entries)
+{
+	ifstream input(path, ios::in);
+	if(!input)	return false;
+
+	readTree(input, entries);
+	return true;
+}
+
+// prints the steps of a sync as vfs commands, changing folder only when needed
+void printScript(const Vector<SyncStep> &steps)
+{
+	string dir;
+	string out;
+
+	for(int i = 0; i < steps.size(); i++)
+	{
+		if(steps[i].op == sync_mv)
+		{
+			out += "mv " + steps[i].dir + " " + steps[i].name + '\n';
+			continue;
+		}
+
+		if(steps[i].dir != dir)
+		{
+			dir = steps[i].dir;
+			out += "cd " + dir + '\n';
+		}
+
+		     if(steps[i].op == sync_mkdir)	out += "mkdir " + steps[i].name + '\n';
+		else if(steps[i].op == sync_touch)	out += "touch " + steps[i].name + " " + to_string(steps[i].size) + '\n';
+		else if(steps[i].op == sync_symlink)	out += "ln -s " + steps[i].target + " " + steps[i].name + '\n';
+		else								out += "rm " + steps[i].name + '\n';
+	}
+
+	cout<<out;
+}
+
+int main(int argc, char **argv)
+{
+	// parses the options
+	bool sync = (argc == 4 && string(argv[1]) == "--sync");
+	if(argc != 3 && !sync)
+	{
+		cerr<<"usage: vfsdiff [--sync] <old> <new>"<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	string old_path = argv[argc - 2];
+	string new_path = argv[argc - 1];
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// reads both trees
+	Vector<DatEntry> from;
+	Vector<DatEntry> to;
+
+	try
+	{
+		if(!loadTree(old_path, from) || !loadTree(new_path, to))
+		{
+			cerr<<"Failed to open "<<(from.empty() ? old_path : new_path)<<endl;
+			return(EXIT_FAILURE);
+		}
+
+		Vector<TreeChange> changes;
+		diffTrees(from, to, changes);
+
+		if(sync)
+		{
+			Vector<SyncStep> steps;
+			planSync(to, changes, steps);
+			printScript(steps);
+		}
+		else
+		{
+			string out;
+			for(int i = 0; i < changes.size(); i++)	out += formatChange(changes[i]);
+			cout<<out;
+		}
+	}
+	catch(exception &e)
+	{
+		cerr<<"Exception: "<<e.what()<<endl;
+		return(EXIT_FAILURE);
+	}
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cerr<<from.size()<<" and "<<to.size()<<" entries compared in "<<elapsed<<" s"<<endl;
+
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,111 @@
+#include "watch.hpp"
+
+// returns true if two events describe the same change, so the newer can be merged into the older
+static bool sameEvent(const WatchEvent &first, const WatchEvent &second) {
+    return first.type == second.type && first.node_type == second.node_type && first.path == second.path;
+}
+
+// creates an empty ring
+WatchRing::WatchRing() : head(0), tail(0) {
+    for (int i = 0; i < WATCH_EVENTS; i++) {
+        slots[i].count.store(0, memory_order_relaxed);
+    }
+}
+
+// merges one event into a slot, unless the consumer already took it
+// -- seeing the slot taken also shows the head the consumer stored before taking it;
+// -- a count that reached its largest value stays there
+bool WatchRing::addCount(atomic<uint32_t> &count) {
+    uint32_t value = count.load(memory_order_acquire);
+    while (value != 0) {
+        if (value == UINT32_MAX || count.compare_exchange_weak(value, value + 1, memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// adds an event, merging it into the newest one when they are equal
+// -- returns false if the ring was full and the event was only counted as dropped
+bool WatchRing::push(const WatchEvent &event) {
+    uint64_t t = tail.load(memory_order_relaxed);
+    uint64_t h = head.load(memory_order_acquire);
+
+    // the newest event is merged into while the consumer has not taken it; a full ring ends with
+    // the overflow record, which counts every event dropped until the consumer catches up
+    // -- moves are never merged, their cookie pairs them with one other event
+    if (t > h) {
+        Slot &last = slots[(t - 1) % WATCH_EVENTS];
+        bool full = (t - h == WATCH_EVENTS);
+
+        if (full || (event.cookie == 0 && last.event.cookie == 0 && sameEvent(last.event, event))) {
+            if (addCount(last.count)) {
+                return !full;
+            }
+
+            // the consumer took the newest event, so it moved head past every event before it
+            h = head.load(memory_order_acquire);
+        }
+    }
+
+    // the last free slot is kept for the overflow record
+    bool fits = (t - h < WATCH_EVENTS - 1);
+    Slot &slot = slots[t % WATCH_EVENTS];
+    if (fits) {
+        slot.event = event;
+    }
+    else {
+        slot.event.type = watch_overflow;
+        slot.event.node_type = folder;
+        slot.event.path.clear();
+        slot.event.cookie = 0;
+    }
+    slot.count.store(1, memory_order_relaxed);
+
+    // publishes the slot to the consumer
+    tail.store(t + 1, memory_order_release);
+    return fits;
+}
+
+// takes up to max events, oldest first, and returns how many were taken
+// -- every event frees its slot as soon as it is copied, so the producer never waits on a batch
+int WatchRing::pop(WatchEvent *batch, int max) {
+    uint64_t h = head.load(memory_order_relaxed);
+    uint64_t t = tail.load(memory_order_acquire);
+
+    int count = 0;
+    for (; count < max && h < t; count++) {
+        Slot &slot = slots[h % WATCH_EVENTS];
+        batch[count] = slot.event;
+
+        // taking the count closes the event to merging, so the count read is final
+        batch[count].count = slot.count.exchange(0, memory_order_acq_rel);
+        head.store(++h, memory_order_release);
+    }
+
+    return count;
+}
+
+// returns the word an event is printed with
+const char* watchTypeName(WatchType type) {
+    switch (type) {
+        case watch_created:
+            return "created";
+        case watch_removed:
+            return "removed";
+        case watch_modified:
+            return "modified";
+        case watch_moved_from:
+            return "moved_from";
+        case watch_moved_to:
+            return "moved_to";
+        case watch_recovered:
+            return "recovered";
+        case watch_purged:
+            return "purged";
+        case watch_overflow:
+            return "overflow";
+        default:
+            return "ended";
+    }
+}
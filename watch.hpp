@@ -0,0 +1,79 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include<cstdint>
+#include<string>
+#include<atomic>
+#include "node.hpp"
+
+using namespace std;
+
+// ---------------- Change notifications -------------------------
+// a watch on a folder receives an event for every node created, removed, written, moved, recovered
+// or purged in it, or anywhere below it for a recursive watch. The events of a watch go through a ring with
+// one producer, the thread changing the tree, and one consumer, which may be another thread; neither
+// side takes a lock. An event equal to the newest one still waiting is merged into it by counting,
+// and once the ring is full the last free slot records how many events were dropped.
+
+// events a ring holds
+const int WATCH_EVENTS = 1024;
+
+// events taken per batch by a consumer
+const int WATCH_BATCH = 64;
+
+// kinds of event
+enum WatchType {
+	watch_created,			//mkdir, touch, cp, ln or a write added the node
+	watch_removed,			//rm moved the node to the bin
+	watch_modified,			//write, append or truncate changed the file
+	watch_moved_from,		//mv took the node away, paired with watch_moved_to by the cookie
+	watch_moved_to,			//mv put the node here, paired with watch_moved_from by the cookie
+	watch_recovered,		//recover took the node out of the bin
+	watch_purged,			//emptying the bin deleted the node removed from here
+	watch_overflow,			//the ring was full, count events were dropped
+	watch_ended,			//the watched folder was deleted, nothing follows
+};
+
+// one change seen by a watch
+struct WatchEvent {
+	WatchType type;			//kind of event
+	NodeType node_type;		//type of the node that changed
+	string path;			//path of the node from the watched folder, its name for a plain watch
+	uint32_t cookie;		//shared by the two events of a move, 0 otherwise
+	uint32_t count;			//events merged into this one, or events dropped by an overflow
+};
+
+// ring of events with one producer and one consumer
+// -- the cursors only grow; a slot is free again once the consumer moved head past it
+class WatchRing
+{
+	private:
+		struct Slot {
+			WatchEvent event;			//event written by the producer
+			atomic<uint32_t> count;		//events merged into it, 0 once the consumer took it
+		};
+
+		Slot slots[WATCH_EVENTS];		//events by cursor modulo WATCH_EVENTS
+		alignas(64) atomic<uint64_t> head;	//next event the consumer takes
+		alignas(64) atomic<uint64_t> tail;	//next slot the producer fills
+
+		bool addCount(atomic<uint32_t> &count);	//merges one event into a slot not taken yet
+	public:
+		WatchRing();
+		bool push(const WatchEvent &event);		//adds an event, false if it was dropped
+		int pop(WatchEvent *batch, int max);	//takes up to max events, oldest first
+};
+
+// subscription to the changes under a folder
+struct Watch {
+	int id;					//number the watch is known by
+	Node *folder;			//watched folder, nullptr once it was deleted
+	bool recursive;			//changes anywhere below the folder are seen, not only in it
+	int session;			//session that set the watch, whose end drops it
+	WatchRing ring;			//events not taken yet
+};
+
+// returns the word an event is printed with
+const char* watchTypeName(WatchType type);
+
+#endif